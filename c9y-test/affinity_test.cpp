@@ -0,0 +1,102 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/affinity.h>
+#include <c9y/thread_pool.h>
+#include <c9y/task_pool.h>
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <gtest/gtest.h>
+
+TEST(affinity, numa_nodes)
+{
+    auto count = c9y::get_numa_node_count();
+    EXPECT_LE(1u, count);
+
+    auto cpus = c9y::get_numa_node_cpus(0u);
+    EXPECT_FALSE(cpus.empty());
+    for (auto cpu : cpus)
+    {
+        EXPECT_EQ(0u, c9y::get_numa_node(cpu));
+    }
+}
+
+TEST(affinity, placement_cpus)
+{
+    EXPECT_TRUE(c9y::get_placement_cpus({}, 4u).empty());
+
+    auto cpus = c9y::get_placement_cpus({.cpus = {0u, 1u}}, 4u);
+    EXPECT_EQ((std::vector<size_t>{0u, 1u, 0u, 1u}), cpus);
+
+    auto spread = c9y::get_placement_cpus({.spread_numa_nodes = true}, 2u);
+    ASSERT_EQ(2u, spread.size());
+    if (c9y::get_numa_node_count() > 1u)
+    {
+        EXPECT_NE(c9y::get_numa_node(spread[0]), c9y::get_numa_node(spread[1]));
+    }
+}
+
+#ifdef __linux__
+TEST(affinity, pin_thread)
+{
+    auto cpu = c9y::get_numa_node_cpus(0u).back();
+
+    auto pool = c9y::thread_pool{[&] () {
+        EXPECT_EQ(cpu, c9y::get_current_cpu());
+    }, 2u, {.cpus = {cpu}}};
+    pool.join();
+}
+
+TEST(affinity, placement_respects_affinity_mask)
+{
+    auto cpu = c9y::get_numa_node_cpus(0u).back();
+
+    // the mask of the calling thread limits the CPUs used
+    auto thread = std::thread{[&] () {
+        ASSERT_TRUE(c9y::set_thread_affinity(cpu));
+        auto spread = c9y::get_placement_cpus({.spread_numa_nodes = true}, 2u);
+        EXPECT_EQ((std::vector<size_t>{cpu, cpu}), spread);
+    }};
+    thread.join();
+}
+#endif
+
+TEST(affinity, task_pool_placement)
+{
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency = 2u,
+        .placement  = {.spread_numa_nodes = true}
+    }};
+
+    auto count = std::atomic<unsigned int>{0u};
+    for (auto i = 0u; i < 100u; i++)
+    {
+        pool.enqueue([&] () {
+            count++;
+        });
+    }
+    pool.flush();
+    EXPECT_EQ(100u, count);
+}
@@ -0,0 +1,161 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/executor.h>
+#include <c9y/async.h>
+#include <c9y/parallel.h>
+#include <c9y/task_pool.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <gtest/gtest.h>
+
+TEST(executor, inline_executor)
+{
+    auto exec = c9y::inline_executor{};
+    auto id   = std::thread::id{};
+    exec.enqueue([&] () {
+        id = std::this_thread::get_id();
+    });
+    EXPECT_EQ(std::this_thread::get_id(), id);
+}
+
+TEST(executor, thread_executor)
+{
+    auto order = std::vector<unsigned int>{};
+    auto ids   = std::vector<std::thread::id>{};
+    {
+        auto exec = c9y::thread_executor{};
+        for (auto i = 0u; i < 10u; i++)
+        {
+            exec.enqueue([&, i] () {
+                order.push_back(i);
+                ids.push_back(std::this_thread::get_id());
+            });
+        }
+    }
+
+    EXPECT_EQ((std::vector<unsigned int>{0u, 1u, 2u, 3u, 4u, 5u, 6u, 7u, 8u, 9u}), order);
+    ASSERT_EQ(10u, ids.size());
+    EXPECT_NE(std::this_thread::get_id(), ids[0]);
+    EXPECT_EQ(10, std::count(begin(ids), end(ids), ids[0]));
+}
+
+TEST(executor, async_with_executor)
+{
+    auto exec   = c9y::thread_executor{};
+    auto future = c9y::async<std::thread::id>(exec, [] () {
+        return std::this_thread::get_id();
+    });
+    EXPECT_NE(std::this_thread::get_id(), future.get());
+}
+
+TEST(executor, parallel_with_executor)
+{
+    auto exec   = c9y::inline_executor{};
+    auto values = std::vector<unsigned int>(1000u);
+    std::iota(begin(values), end(values), 0u);
+
+    auto ids = std::vector<std::thread::id>(values.size());
+    c9y::parallel_transform(exec, begin(values), end(values), begin(ids), [] (auto) {
+        return std::this_thread::get_id();
+    });
+    EXPECT_EQ(ids.size(), std::count(begin(ids), end(ids), std::this_thread::get_id()));
+
+    EXPECT_EQ(499500u, c9y::parallel_reduce(exec, begin(values), end(values), 0u));
+}
+
+TEST(executor, nested_parallel_on_pool)
+{
+    auto pool  = c9y::task_pool{2u};
+    auto count = std::atomic<unsigned int>{0u};
+    auto outer = std::vector<unsigned int>(8u);
+
+    c9y::parallel_for_each(pool, begin(outer), end(outer), [&] (auto) {
+        auto inner = std::vector<unsigned int>(100u);
+        c9y::parallel_for_each(pool, begin(inner), end(inner), [&] (auto) {
+            count++;
+        }, 10u);
+    }, 1u);
+
+    EXPECT_EQ(800u, count);
+}
+
+TEST(executor, scoped_executor)
+{
+    auto exec = c9y::inline_executor{};
+    EXPECT_EQ(nullptr, c9y::get_current_executor());
+    {
+        auto scope = c9y::scoped_executor{exec};
+        EXPECT_EQ(&exec, c9y::get_current_executor());
+
+        auto id = std::thread::id{};
+        c9y::async([&] () {
+            id = std::this_thread::get_id();
+        });
+        EXPECT_EQ(std::this_thread::get_id(), id);
+
+        auto values = std::vector<unsigned int>(100u, 1u);
+        auto ids    = std::vector<std::thread::id>(values.size());
+        c9y::parallel_transform(begin(values), end(values), begin(ids), [] (auto) {
+            return std::this_thread::get_id();
+        });
+        EXPECT_EQ(ids.size(), std::count(begin(ids), end(ids), std::this_thread::get_id()));
+
+        {
+            auto other = c9y::thread_executor{};
+            auto inner = c9y::scoped_executor{other};
+            EXPECT_EQ(&other, c9y::get_current_executor());
+        }
+        EXPECT_EQ(&exec, c9y::get_current_executor());
+    }
+    EXPECT_EQ(nullptr, c9y::get_current_executor());
+}
+
+TEST(executor, notify_run_until)
+{
+    auto pool   = c9y::task_pool{2u};
+    auto exec   = c9y::thread_executor{};
+    auto flag   = std::atomic<bool>{false};
+    auto helped = std::atomic<unsigned int>{0u};
+
+    pool.enqueue([&] () {
+        pool.run_until([&] () {return flag.load();});
+        helped++;
+    });
+    exec.enqueue([&] () {
+        exec.run_until([&] () {return flag.load();});
+        helped++;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    flag = true;
+    pool.notify_run_until();
+    exec.notify_run_until();
+
+    pool.run_until([&] () {return helped == 2u;});
+    EXPECT_EQ(2u, helped);
+}
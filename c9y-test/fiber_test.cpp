@@ -0,0 +1,302 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/fiber.h>
+#include <c9y/task_pool.h>
+#include <c9y/latch.h>
+#include <c9y/queue.h>
+#include <c9y/mpmc_queue.h>
+#include <c9y/priority_queue.h>
+#include <c9y/parallel.h>
+#include <c9y/barrier.h>
+#include <c9y/task_group.h>
+#include <c9y/select.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+TEST(fiber, resume_and_suspend)
+{
+    auto steps = std::vector<int>{};
+    auto f = c9y::fiber{[&] () {
+        steps.push_back(1);
+        c9y::fiber::suspend();
+        steps.push_back(3);
+    }};
+
+    EXPECT_EQ(nullptr, c9y::fiber::current());
+    EXPECT_FALSE(f.resume());
+    steps.push_back(2);
+    EXPECT_TRUE(f.resume());
+    EXPECT_TRUE(f.done());
+
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), steps);
+}
+
+TEST(fiber, park_and_wake)
+{
+    auto steps = std::vector<int>{};
+    auto f = c9y::fiber{[&] () {
+        steps.push_back(1);
+        c9y::fiber::park();
+        steps.push_back(3);
+    }};
+
+    EXPECT_FALSE(f.resume());
+    EXPECT_TRUE(f.is_parked());
+    EXPECT_FALSE(f.get_deadline().has_value());
+
+    // the fiber is only resumed by it's waker
+    auto woken = false;
+    f.on_wake([&] () {
+        woken = true;
+    });
+    steps.push_back(2);
+    EXPECT_FALSE(woken);
+    f.wake();
+    EXPECT_TRUE(woken);
+
+    EXPECT_TRUE(f.resume());
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), steps);
+}
+
+TEST(fiber, wake_before_park)
+{
+    auto f = c9y::fiber{[&] () {
+        c9y::fiber::park();
+    }};
+
+    // a wake that comes while the fiber is parking is not lost
+    f.wake();
+    EXPECT_FALSE(f.resume());
+    auto woken = false;
+    f.on_wake([&] () {
+        woken = true;
+    });
+    EXPECT_TRUE(woken);
+    EXPECT_TRUE(f.resume());
+}
+
+TEST(fiber, blocked_fibers_free_the_worker)
+{
+    // many more waiting fibers than threads
+    auto pool  = c9y::task_pool{2u};
+    auto gate  = c9y::latch{1};
+    auto count = std::atomic<unsigned int>{0u};
+
+    for (auto i = 0u; i < 100u; i++)
+    {
+        pool.enqueue_fiber([&] () {
+            gate.wait();
+            count++;
+        });
+    }
+
+    // the workers are still free for normal tasks
+    auto done = std::atomic<bool>{false};
+    pool.enqueue([&] () {
+        done = true;
+    });
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(0u, count);
+
+    gate.count_down();
+    pool.flush();
+    EXPECT_EQ(100u, count);
+}
+
+TEST(fiber, queue_in_fiber)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto q      = c9y::queue<int>{};
+    auto result = std::atomic<int>{0};
+
+    pool.enqueue_fiber([&] () {
+        auto value = q.pop_wait();
+        result = value.value_or(-1);
+    });
+    pool.enqueue_fiber([&] () {
+        auto value = q.pop_wait_for(std::chrono::milliseconds(1));
+        EXPECT_FALSE(value.has_value());
+        q.push(42);
+    });
+
+    pool.flush();
+    EXPECT_EQ(42, result);
+}
+
+TEST(fiber, parallel_in_fiber)
+{
+    auto pool   = c9y::task_pool{2u};
+    auto result = std::atomic<unsigned int>{0u};
+
+    pool.enqueue_fiber([&] () {
+        auto values = std::vector<unsigned int>(1000u, 1u);
+        result = c9y::parallel_reduce(pool, begin(values), end(values), 0u);
+    });
+
+    pool.flush();
+    EXPECT_EQ(1000u, result);
+}
+
+TEST(fiber, run_until_in_fiber)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto flag   = std::atomic<bool>{false};
+    auto checks = std::atomic<unsigned int>{0u};
+    auto done   = std::atomic<bool>{false};
+
+    pool.enqueue_fiber([&] () {
+        pool.run_until([&] () {
+            checks++;
+            return flag.load();
+        });
+        done = true;
+    });
+
+    // the fiber parks instead of checking the condition over and over
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_GE(1u, checks);
+    EXPECT_FALSE(done);
+
+    flag = true;
+    pool.notify_run_until();
+    pool.flush();
+    EXPECT_TRUE(done);
+    EXPECT_GE(2u, checks);
+}
+
+TEST(fiber, barrier_in_fiber)
+{
+    // more fibers than workers, so the barrier only completes if they park
+    auto pool    = c9y::task_pool{1u};
+    auto barrier = c9y::barrier{4};
+    auto count   = std::atomic<unsigned int>{0u};
+
+    for (auto i = 0; i < 4; i++)
+    {
+        pool.enqueue_fiber([&] () {
+            barrier.arrive_and_wait();
+            count++;
+        });
+    }
+
+    pool.flush();
+    EXPECT_EQ(4u, count);
+}
+
+TEST(fiber, task_group_in_fiber)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    pool.enqueue_fiber([&] () {
+        auto group = c9y::task_group{pool};
+        for (auto i = 0; i < 10; i++)
+        {
+            group.run([&] () {
+                count++;
+            });
+        }
+        group.wait();
+        EXPECT_EQ(10u, count);
+    });
+
+    pool.flush();
+    EXPECT_EQ(10u, count);
+}
+
+TEST(fiber, queue_capacity_in_fiber)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto q      = c9y::queue<int>{};
+    auto values = std::vector<int>{};
+    q.set_capacity(1u);
+
+    // the producer parks on the full queue until the consumer pops
+    pool.enqueue_fiber([&] () {
+        for (auto i = 0; i < 10; i++)
+        {
+            q.push(i);
+        }
+    });
+    pool.enqueue_fiber([&] () {
+        for (auto i = 0; i < 10; i++)
+        {
+            values.push_back(*q.pop_wait());
+        }
+    });
+
+    pool.flush();
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), values);
+}
+
+TEST(fiber, select_in_fiber)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto a      = c9y::queue<int>{};
+    auto b      = c9y::queue<int>{};
+    auto result = std::atomic<size_t>{99u};
+
+    pool.enqueue_fiber([&] () {
+        EXPECT_FALSE(c9y::select_for(c9y::select_policy::prioritized, std::chrono::milliseconds(1), a, b).has_value());
+        result = c9y::select(c9y::select_policy::prioritized, a, b);
+    });
+    pool.enqueue_fiber([&] () {
+        c9y::fiber::suspend(std::chrono::milliseconds(5));
+        b.push(1);
+    });
+
+    pool.flush();
+    EXPECT_EQ(1u, result);
+}
+
+TEST(fiber, lock_free_queues_in_fiber)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto mpmc   = c9y::mpmc_queue<int>{2u};
+    auto prio   = c9y::priority_queue<int>{};
+    auto result = std::atomic<int>{0};
+
+    // the consumers park on the empty queues and free the only worker
+    pool.enqueue_fiber([&] () {
+        result += mpmc.pop_wait().value_or(-100);
+    });
+    pool.enqueue_fiber([&] () {
+        result += prio.pop_wait().value_or(-100);
+    });
+    pool.enqueue_fiber([&] () {
+        c9y::fiber::suspend(std::chrono::milliseconds(5));
+        mpmc.push(1);
+        prio.push(2);
+    });
+
+    pool.flush();
+    EXPECT_EQ(3, result);
+}
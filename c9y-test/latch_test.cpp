@@ -65,3 +65,13 @@ TEST(latch, wait_for)
     EXPECT_EQ(12u, count);
 }
 #endif
+
+TEST(latch, try_wait)
+{
+    auto my_latch = c9y::latch{2u};
+    EXPECT_FALSE(my_latch.try_wait());
+    my_latch.count_down();
+    EXPECT_FALSE(my_latch.try_wait());
+    my_latch.count_down();
+    EXPECT_TRUE(my_latch.try_wait());
+}
@@ -0,0 +1,156 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/mpmc_queue.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <c9y/thread_pool.h>
+#include <c9y/task_pool.h>
+
+using namespace std::chrono_literals;
+
+TEST(mpmc_queue, capacity_is_power_of_two)
+{
+    EXPECT_EQ(2u, c9y::mpmc_queue<int>{0u}.capacity());
+    EXPECT_EQ(8u, c9y::mpmc_queue<int>{8u}.capacity());
+    EXPECT_EQ(16u, c9y::mpmc_queue<int>{9u}.capacity());
+}
+
+TEST(mpmc_queue, fifo_until_full)
+{
+    auto q = c9y::mpmc_queue<int>{4u};
+    for (auto i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+
+    for (auto i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(i, q.pop());
+    }
+    EXPECT_EQ(std::nullopt, q.pop());
+}
+
+TEST(mpmc_queue, destroys_remaining)
+{
+    auto value = std::make_shared<int>(42);
+    {
+        auto q = c9y::mpmc_queue<std::shared_ptr<int>>{4u};
+        q.push(value);
+        q.push(value);
+        EXPECT_EQ(3, value.use_count());
+    }
+    EXPECT_EQ(1, value.use_count());
+}
+
+TEST(mpmc_queue, consumer_producer)
+{
+    // small capacity so producers block on a full queue
+    auto q     = c9y::mpmc_queue<int>{8u};
+    auto count = std::atomic<unsigned int>{0};
+
+    auto cons = c9y::thread_pool{[&] () {
+        while (auto value = q.pop_wait())
+        {
+            count += *value;
+        }
+    }, 3};
+
+    auto prod = c9y::thread_pool{[&] () {
+        for (int i = 1; i < 1001; i++)
+        {
+            q.push(i);
+        }
+    }, 3};
+
+    prod.join();
+    while (count != 3u * 500500u)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    q.stop();
+    cons.join();
+
+    EXPECT_EQ(3u * 500500u, count.load());
+}
+
+TEST(mpmc_queue, pop_wait_for_times_out)
+{
+    auto q = c9y::mpmc_queue<int>{4u};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::nullopt, q.pop_wait_for(20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(mpmc_queue, stop_wakes_waiting)
+{
+    auto q     = c9y::mpmc_queue<int>{2u};
+    auto woken = std::atomic<unsigned int>{0u};
+
+    EXPECT_TRUE(q.push(1));
+    EXPECT_TRUE(q.push(2));
+
+    auto prod = c9y::thread_pool{[&] () {
+        EXPECT_FALSE(q.push(3));
+        woken++;
+    }, 2};
+
+    std::this_thread::sleep_for(20ms);
+    q.stop();
+    prod.join();
+
+    EXPECT_EQ(2u, woken.load());
+    // values pushed before stop can still be poped
+    EXPECT_EQ(1, q.pop_wait());
+    EXPECT_EQ(2, q.pop_wait());
+    EXPECT_EQ(std::nullopt, q.pop_wait());
+}
+
+TEST(mpmc_queue, pop_wait_in_fiber)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto q     = c9y::mpmc_queue<int>{4u};
+    auto value = std::atomic<int>{0};
+
+    pool.enqueue_fiber([&] () {
+        value = q.pop_wait().value_or(-1);
+    });
+    // the single worker must stay free while the fiber waits
+    auto ran = std::atomic<bool>{false};
+    pool.enqueue([&] () {
+        ran = true;
+    });
+    while (!ran)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    q.push(7);
+    pool.flush();
+    EXPECT_EQ(7, value.load());
+}
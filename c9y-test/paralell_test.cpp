@@ -195,6 +195,38 @@ TEST(parallel, parallel_copy)
     EXPECT_EQ(source[42], result[42]);
 }
 
+TEST(parallel, parallel_transform_uneven_chunks)
+{
+    auto source = std::vector<unsigned int>(1000);
+    auto result = std::vector<unsigned int>(1000);
+
+    auto idx = 0u;
+    std::generate(begin(source), end(source), [&] () {
+        return ++idx;
+    });
+
+    c9y::parallel_transform(begin(source), end(source), begin(result), [] (auto value) {
+        return value + 1;
+    }, 300u);
+    for (auto i = 0u; i < source.size(); i++)
+    {
+        EXPECT_EQ(source[i] + 1, result[i]);
+    }
+}
+
+TEST(parallel, parallel_copy_uneven_chunks)
+{
+    auto source = std::vector<unsigned int>(1000);
+    auto result = std::vector<unsigned int>(1000);
+
+    std::generate(begin(source), end(source), [&] () {
+        return std::rand();
+    });
+
+    c9y::parallel_copy(begin(source), end(source), begin(result), 300u);
+    EXPECT_EQ(source, result);
+}
+
 TEST(parallel, parallel_reduce)
 {
     auto values = std::vector<unsigned int>(1000);
@@ -266,3 +298,18 @@ TEST(parallel, parallel_map_reduce)
     EXPECT_EQ(8, result["non"]);
     EXPECT_EQ(7, result["arcu"]);
 }
+
+TEST(parallel, nested_parallel_for_each)
+{
+    auto rows  = std::vector<std::vector<unsigned int>>(16u, std::vector<unsigned int>(100u, 1u));
+    auto count = std::atomic<unsigned int>{0u};
+
+    // each outer task waits for it's inner loop on the same pool
+    c9y::parallel_for_each(begin(rows), end(rows), [&] (auto& row) {
+        c9y::parallel_for_each(begin(row), end(row), [&] (auto value) {
+            count += value;
+        }, 10u);
+    }, 1u);
+
+    EXPECT_EQ(1600u, count);
+}
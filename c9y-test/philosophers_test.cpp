@@ -263,6 +263,8 @@ TEST(philosophers, async_and_sync)
     {
         c9y::sync_point();
     }
+    // release the forks of the last meals, they reference this stack
+    c9y::sync_point();
 
     c9y::wait_all(results);
 }
@@ -0,0 +1,132 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/priority_queue.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <c9y/thread_pool.h>
+
+using namespace std::chrono_literals;
+
+TEST(priority_queue, strict_order)
+{
+    auto q = c9y::priority_queue<int>{c9y::priority_order::strict};
+    for (auto v : {5, 1, 9, 3, 7})
+    {
+        q.push(v);
+    }
+
+    for (auto v : {9, 7, 5, 3, 1})
+    {
+        EXPECT_EQ(v, q.pop());
+    }
+    EXPECT_EQ(std::nullopt, q.pop());
+}
+
+TEST(priority_queue, strict_order_greater)
+{
+    auto q = c9y::priority_queue<int, std::greater<int>>{c9y::priority_order::strict};
+    for (auto v : {5, 1, 9, 3, 7})
+    {
+        q.push(v);
+    }
+
+    for (auto v : {1, 3, 5, 7, 9})
+    {
+        EXPECT_EQ(v, q.pop());
+    }
+}
+
+TEST(priority_queue, relaxed_returns_all)
+{
+    auto q = c9y::priority_queue<int>{};
+    for (auto i = 0; i < 1000; i++)
+    {
+        q.push(i);
+    }
+
+    auto seen = std::vector<bool>(1000u, false);
+    while (auto value = q.pop())
+    {
+        EXPECT_FALSE(seen[*value]);
+        seen[*value] = true;
+    }
+    EXPECT_EQ(std::vector<bool>(1000u, true), seen);
+}
+
+TEST(priority_queue, relaxed_is_roughly_ordered)
+{
+    auto q = c9y::priority_queue<int>{};
+    for (auto i = 0; i < 10000; i++)
+    {
+        q.push(i);
+    }
+
+    // the first values come from the top of the lanes
+    for (auto i = 0; i < 10; i++)
+    {
+        EXPECT_LT(9000, q.pop().value());
+    }
+}
+
+TEST(priority_queue, consumer_producer)
+{
+    auto q     = c9y::priority_queue<int>{};
+    auto count = std::atomic<unsigned int>{0};
+
+    auto cons = c9y::thread_pool{[&] () {
+        while (auto value = q.pop_wait())
+        {
+            count += *value;
+        }
+    }, 3};
+
+    auto prod = c9y::thread_pool{[&] () {
+        for (int i = 1; i < 1001; i++)
+        {
+            q.push(i);
+        }
+    }, 3};
+
+    prod.join();
+    while (count != 3u * 500500u)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    q.stop();
+    cons.join();
+
+    EXPECT_EQ(3u * 500500u, count.load());
+}
+
+TEST(priority_queue, pop_wait_for_times_out)
+{
+    auto q = c9y::priority_queue<int>{};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::nullopt, q.pop_wait_for(20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
@@ -25,6 +25,7 @@
 
 #include <atomic>
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <c9y/thread_pool.h>
@@ -171,3 +172,180 @@ TEST(queue, consumer_producer_wait_movable)
 
     EXPECT_EQ(15150, static_cast<unsigned int>(count));
 }
+
+TEST(queue, push_range_pop_n)
+{
+    auto q = c9y::queue<int>{};
+    auto in = std::vector<int>{1, 2, 3, 4, 5};
+    q.push_range(in.begin(), in.end());
+
+    auto out = std::vector<int>{};
+    EXPECT_EQ(2u, q.pop_n(std::back_inserter(out), 2u));
+    EXPECT_EQ((std::vector<int>{1, 2}), out);
+
+    EXPECT_EQ(3u, q.pop_n(std::back_inserter(out), 10u));
+    EXPECT_EQ(in, out);
+
+    EXPECT_EQ(0u, q.pop_n(std::back_inserter(out), 10u));
+}
+
+TEST(queue, pop_all_wait)
+{
+    auto q     = c9y::queue<movable>{};
+    auto count = std::atomic<unsigned int>{0};
+
+    auto cons = c9y::thread_pool{[&] () {
+        auto values = std::vector<movable>{};
+        while (q.pop_all_wait(std::back_inserter(values)) != 0u)
+        {
+            for (const auto& m : values)
+            {
+                count += m.value;
+            }
+            values.clear();
+        }
+    }, 2};
+
+    for (int i = 1; i < 101; i++)
+    {
+        q.emplace(i);
+        if (i % 10 == 0)
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+    }
+
+    while (count != 5050u)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    q.stop();
+    cons.join();
+
+    EXPECT_EQ(5050u, count.load());
+}
+
+TEST(queue, bounded_try_push)
+{
+    auto q = c9y::queue<int>{};
+    q.set_capacity(2u);
+    EXPECT_EQ(2u, q.get_capacity());
+
+    EXPECT_TRUE(q.try_push(1));
+    EXPECT_TRUE(q.try_push(2));
+    EXPECT_FALSE(q.try_push(3));
+    EXPECT_FALSE(q.push_wait_for(3, 10ms));
+
+    EXPECT_EQ(1, q.pop());
+    EXPECT_TRUE(q.push_wait_for(3, 10ms));
+    EXPECT_EQ(2, q.pop());
+    EXPECT_EQ(3, q.pop());
+}
+
+TEST(queue, bounded_push_blocks)
+{
+    auto q      = c9y::queue<int>{};
+    auto pushed = std::atomic<unsigned int>{0};
+    q.set_capacity(4u);
+
+    auto prod = c9y::thread_pool{[&] () {
+        for (int i = 0; i < 10; i++)
+        {
+            q.push(i);
+            pushed++;
+        }
+    }, 1};
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(4u, pushed.load());
+
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(i, q.pop_wait());
+    }
+    prod.join();
+    EXPECT_EQ(10u, pushed.load());
+}
+
+TEST(queue, bounded_consumer_producer)
+{
+    auto q     = c9y::queue<int>{};
+    auto count = std::atomic<unsigned int>{0};
+    q.set_capacity(8u);
+
+    auto cons = c9y::thread_pool{[&] () {
+        while (auto value = q.pop_wait())
+        {
+            count += *value;
+        }
+    }, 3};
+
+    auto prod = c9y::thread_pool{[&] () {
+        auto values = std::vector<int>{};
+        for (int i = 1; i < 101; i++)
+        {
+            values.push_back(i);
+        }
+        q.push_range(values.begin(), values.end());
+        for (int i = 1; i < 101; i++)
+        {
+            q.emplace(i);
+        }
+    }, 3};
+
+    prod.join();
+    while (count != 6u * 5050u)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    q.stop();
+    cons.join();
+
+    EXPECT_EQ(6u * 5050u, count.load());
+}
+
+TEST(queue, stop_releases_producers)
+{
+    auto q = c9y::queue<int>{};
+    q.set_capacity(1u);
+    q.push(1);
+
+    auto prod = c9y::thread_pool{[&] () {
+        q.push(2);
+    }, 2};
+
+    std::this_thread::sleep_for(20ms);
+    q.stop();
+    prod.join();
+
+    auto out = std::vector<int>{};
+    EXPECT_EQ(3u, q.pop_n(std::back_inserter(out), 10u));
+}
+
+TEST(queue, push_wakes_parked_consumers)
+{
+    auto q     = c9y::queue<int>{};
+    auto count = std::atomic<unsigned int>{0};
+
+    auto cons = c9y::thread_pool{[&] () {
+        while (auto value = q.pop_wait())
+        {
+            count += *value;
+        }
+    }, 4};
+
+    // give the consumers time to park
+    std::this_thread::sleep_for(20ms);
+    auto values = std::vector<int>{1, 2, 3, 4};
+    q.push_range(values.begin(), values.end());
+    std::this_thread::sleep_for(20ms);
+    q.push(5);
+
+    while (count != 15u)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    q.stop();
+    cons.join();
+    EXPECT_EQ(15u, count.load());
+}
@@ -0,0 +1,174 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/select.h>
+#include <c9y/queue.h>
+
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <c9y/jthread.h>
+#include <c9y/task_pool.h>
+
+using namespace std::chrono_literals;
+
+TEST(select, reports_ready_queue)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<std::string>{};
+
+    b.push("hello");
+    EXPECT_EQ(1u, c9y::select(c9y::select_policy::prioritized, a, b));
+    EXPECT_EQ("hello", b.pop());
+
+    a.push(1);
+    EXPECT_EQ(0u, c9y::select(c9y::select_policy::prioritized, a, b));
+}
+
+TEST(select, prioritized_prefers_first)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+    a.push(1);
+    b.push(2);
+
+    for (auto i = 0u; i < 4u; i++)
+    {
+        EXPECT_EQ(0u, c9y::select(c9y::select_policy::prioritized, a, b));
+    }
+}
+
+TEST(select, fair_takes_turns)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+    auto c = c9y::queue<int>{};
+    a.push(1);
+    b.push(2);
+    c.push(3);
+
+    auto sel    = c9y::selector{c9y::select_policy::fair};
+    auto first  = sel.select(a, b, c);
+    auto second = sel.select(a, b, c);
+    auto third  = sel.select(a, b, c);
+    EXPECT_EQ((first + 1u) % 3u, second);
+    EXPECT_EQ((first + 2u) % 3u, third);
+}
+
+TEST(select, selectors_keep_their_own_turn)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+    a.push(1);
+    b.push(2);
+
+    // an other selector on the same thread does not move the turn
+    auto first  = c9y::selector{};
+    auto second = c9y::selector{};
+    EXPECT_EQ(0u, first.select(a, b));
+    EXPECT_EQ(0u, second.select(a, b));
+    EXPECT_EQ(1u, first.select(a, b));
+    EXPECT_EQ(1u, second.select(a, b));
+    EXPECT_EQ(0u, first.select(a, b));
+}
+
+TEST(select, fair_without_selector_finds_the_ready_queue)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+    a.push(1);
+
+    // only one queue is ready, so the random start does not matter
+    for (auto i = 0u; i < 4u; i++)
+    {
+        EXPECT_EQ(0u, c9y::select(c9y::select_policy::fair, a, b));
+    }
+}
+
+TEST(select, waits_for_push)
+{
+    auto control = c9y::queue<int>{};
+    auto data    = c9y::queue<int>{};
+
+    auto prod = c9y::jthread{[&] () {
+        std::this_thread::sleep_for(20ms);
+        data.push(42);
+    }};
+
+    EXPECT_EQ(1u, c9y::select(c9y::select_policy::prioritized, control, data));
+    EXPECT_EQ(42, data.pop());
+    prod.join();
+}
+
+TEST(select, wakes_on_stop)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+
+    auto stopper = c9y::jthread{[&] () {
+        std::this_thread::sleep_for(20ms);
+        a.stop();
+    }};
+
+    EXPECT_EQ(0u, c9y::select(c9y::select_policy::fair, a, b));
+    EXPECT_EQ(std::nullopt, a.pop());
+    stopper.join();
+}
+
+TEST(select, select_for_times_out)
+{
+    auto a = c9y::queue<int>{};
+    auto b = c9y::queue<int>{};
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::nullopt, c9y::select_for(c9y::select_policy::prioritized, 20ms, a, b));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(select, selector_select_for_times_out)
+{
+    auto a   = c9y::queue<int>{};
+    auto sel = c9y::selector{};
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::nullopt, sel.select_for(20ms, a));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(select, in_fiber)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto a     = c9y::queue<int>{};
+    auto b     = c9y::queue<int>{};
+    auto index = std::atomic<size_t>{99u};
+
+    pool.enqueue_fiber([&] () {
+        index = c9y::select(c9y::select_policy::prioritized, a, b);
+    });
+    std::this_thread::sleep_for(10ms);
+    b.push(1);
+    pool.flush();
+
+    EXPECT_EQ(1u, index.load());
+}
@@ -0,0 +1,209 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/spsc_queue.h>
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <c9y/jthread.h>
+
+using namespace std::chrono_literals;
+
+template <typename Queue>
+concept waitable = requires (Queue& q) { q.pop_wait(); };
+
+// waiting is opt in, the default queue only has the non blocking interface
+static_assert(!waitable<c9y::spsc_queue<int>>);
+static_assert(waitable<c9y::spsc_queue<int, true>>);
+
+TEST(spsc_queue, fifo_until_full)
+{
+    auto q = c9y::spsc_queue<int>{4u};
+    EXPECT_EQ(4u, q.capacity());
+    for (auto i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+
+    for (auto i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(i, q.pop());
+    }
+    EXPECT_EQ(std::nullopt, q.pop());
+}
+
+TEST(spsc_queue, spans_stop_at_wrap)
+{
+    auto q = c9y::spsc_queue<int>{4u};
+    EXPECT_TRUE(q.try_push(0));
+    EXPECT_TRUE(q.try_push(1));
+    EXPECT_TRUE(q.try_push(2));
+    EXPECT_EQ(0, q.pop());
+    EXPECT_EQ(1, q.pop());
+
+    // two free slots at the end, one at the start
+    auto ws = q.write_span();
+    ASSERT_EQ(1u, ws.size());
+    ws[0] = 3;
+    q.commit_write(1u);
+    ws = q.write_span();
+    ASSERT_EQ(2u, ws.size());
+    ws[0] = 4;
+    ws[1] = 5;
+    q.commit_write(2u);
+    EXPECT_TRUE(q.write_span().empty());
+
+    auto rs = q.read_span();
+    ASSERT_EQ(2u, rs.size());
+    EXPECT_EQ(2, rs[0]);
+    EXPECT_EQ(3, rs[1]);
+    q.commit_read(2u);
+    rs = q.read_span(8u);
+    ASSERT_EQ(2u, rs.size());
+    EXPECT_EQ(4, rs[0]);
+    EXPECT_EQ(5, rs[1]);
+    q.commit_read(1u);
+    EXPECT_EQ(5, q.pop());
+    EXPECT_TRUE(q.read_span().empty());
+}
+
+TEST(spsc_queue, consumer_producer)
+{
+    auto q        = c9y::spsc_queue<unsigned int, true>{16u};
+    auto received = std::vector<unsigned int>{};
+
+    auto cons = c9y::jthread{[&] () {
+        while (auto value = q.pop_wait())
+        {
+            received.push_back(*value);
+        }
+    }};
+
+    for (auto i = 0u; i < 10000u; i++)
+    {
+        q.push(i);
+    }
+    // values pushed before stop are still delivered
+    q.stop();
+    cons.join();
+
+    ASSERT_EQ(10000u, received.size());
+    for (auto i = 0u; i < 10000u; i++)
+    {
+        EXPECT_EQ(i, received[i]);
+    }
+}
+
+TEST(spsc_queue, non_blocking_consumer_producer)
+{
+    auto q        = c9y::spsc_queue<unsigned int>{16u};
+    auto received = std::vector<unsigned int>{};
+
+    auto cons = c9y::jthread{[&] () {
+        while (received.size() < 10000u)
+        {
+            if (auto value = q.pop())
+            {
+                received.push_back(*value);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    for (auto i = 0u; i < 10000u; i++)
+    {
+        while (!q.try_push(i))
+        {
+            std::this_thread::yield();
+        }
+    }
+    cons.join();
+
+    for (auto i = 0u; i < 10000u; i++)
+    {
+        EXPECT_EQ(i, received[i]);
+    }
+}
+
+TEST(spsc_queue, batch_consumer_producer)
+{
+    auto q   = c9y::spsc_queue<unsigned int, true>{64u};
+    auto sum = 0ull;
+
+    auto cons = c9y::jthread{[&] () {
+        while (q.wait_readable())
+        {
+            auto span = q.read_span();
+            for (auto value : span)
+            {
+                sum += value;
+            }
+            q.commit_read(span.size());
+        }
+    }};
+
+    auto next = 0u;
+    while (next < 10000u && q.wait_writable())
+    {
+        auto span = q.write_span(10000u - next);
+        for (auto& slot : span)
+        {
+            slot = next++;
+        }
+        q.commit_write(span.size());
+    }
+    q.stop();
+    cons.join();
+
+    EXPECT_EQ(10000ull * 9999ull / 2ull, sum);
+}
+
+TEST(spsc_queue, pop_wait_for_times_out)
+{
+    auto q = c9y::spsc_queue<int, true>{4u};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::nullopt, q.pop_wait_for(20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(spsc_queue, stop_wakes_producer)
+{
+    auto q = c9y::spsc_queue<int, true>{1u};
+    EXPECT_TRUE(q.push(1));
+
+    auto prod = c9y::jthread{[&] () {
+        EXPECT_FALSE(q.push(2));
+    }};
+
+    std::this_thread::sleep_for(20ms);
+    q.stop();
+    prod.join();
+    EXPECT_EQ(1, q.pop_wait());
+    EXPECT_EQ(std::nullopt, q.pop_wait());
+}
@@ -0,0 +1,102 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/strand.h>
+#include <c9y/task_pool.h>
+#include <c9y/parallel.h>
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <gtest/gtest.h>
+
+TEST(strand, fifo_order)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto order = std::vector<unsigned int>{};
+    {
+        auto s = c9y::strand{pool};
+        for (auto i = 0u; i < 1000u; i++)
+        {
+            s.enqueue([&, i] () {
+                order.push_back(i);
+            });
+        }
+    }
+
+    ASSERT_EQ(1000u, order.size());
+    for (auto i = 0u; i < 1000u; i++)
+    {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+TEST(strand, one_at_a_time)
+{
+    auto pool    = c9y::task_pool{4u};
+    auto running = std::vector<std::atomic<unsigned int>>(8u);
+    auto overlap = std::atomic<bool>{false};
+    auto count   = std::atomic<unsigned int>{0u};
+    {
+        auto strands = std::vector<std::unique_ptr<c9y::strand>>{};
+        for (auto i = 0u; i < 8u; i++)
+        {
+            strands.push_back(std::make_unique<c9y::strand>(pool, 4u));
+        }
+
+        for (auto i = 0u; i < 800u; i++)
+        {
+            auto s = i % 8u;
+            strands[s]->enqueue([&, s] () {
+                if (running[s]++ != 0u)
+                {
+                    overlap = true;
+                }
+                count++;
+                running[s]--;
+            });
+        }
+    }
+
+    EXPECT_FALSE(overlap);
+    EXPECT_EQ(800u, count);
+}
+
+TEST(strand, parallel_on_strand)
+{
+    auto pool   = c9y::task_pool{2u};
+    auto s      = c9y::strand{pool};
+    auto values = std::vector<unsigned int>(100u, 1u);
+    auto done   = std::atomic<bool>{false};
+
+    // a task of the strand waits for more tasks on the same strand
+    s.enqueue([&] () {
+        auto sum = c9y::parallel_reduce(s, begin(values), end(values), 0u, 10u);
+        EXPECT_EQ(100u, sum);
+        done = true;
+    });
+
+    pool.run_until([&] () {
+        return done.load();
+    });
+}
@@ -23,6 +23,8 @@
 
 #include <c9y/sync.h>
 
+#include <memory>
+
 #include <gtest/gtest.h>
 
 using namespace std::literals::chrono_literals;
@@ -164,6 +166,16 @@ TEST(sync, same_thread_shortcut_with_reault)
     EXPECT_EQ(42u, result);
 }
 
+TEST(sync, sync_with_result_move_only)
+{
+    auto value = std::make_unique<unsigned int>(42u);
+    auto f = c9y::sync<unsigned int>(std::this_thread::get_id(), [value = std::move(value)] () {
+        return *value;
+    });
+
+    EXPECT_EQ(42u, f.get());
+}
+
 TEST(sync, same_thread_shortcut_main_thread)
 {
     c9y::set_main_thread_id(std::this_thread::get_id());
@@ -0,0 +1,92 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/task_group.h>
+
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+
+TEST(task_group, run_and_wait)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto group = c9y::task_group{pool};
+    auto count = std::atomic<unsigned int>{0u};
+
+    for (auto i = 0u; i < 100u; i++)
+    {
+        group.run([&] () {
+            count++;
+        });
+    }
+
+    group.wait();
+    EXPECT_EQ(100u, count);
+}
+
+TEST(task_group, ignores_unrelated_work)
+{
+    auto pool  = c9y::task_pool{2u};
+    auto gate  = std::promise<void>{};
+    auto count = std::atomic<unsigned int>{0u};
+
+    pool.enqueue([f = gate.get_future()] () {
+        f.wait();
+    });
+
+    {
+        auto group = c9y::task_group{pool};
+        for (auto i = 0u; i < 10u; i++)
+        {
+            group.run([&] () {
+                count++;
+            });
+        }
+        group.wait();
+        EXPECT_EQ(10u, count);
+    }
+
+    gate.set_value();
+    pool.flush();
+}
+
+TEST(task_group, nested_wait)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    pool.enqueue([&] () {
+        auto group = c9y::task_group{pool};
+        for (auto i = 0u; i < 10u; i++)
+        {
+            group.run([&] () {
+                count++;
+            });
+        }
+        group.wait();
+        EXPECT_EQ(10u, count);
+    });
+
+    pool.flush();
+    EXPECT_EQ(10u, count);
+}
@@ -0,0 +1,784 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/task_pool.h>
+
+#include <atomic>
+#include <set>
+#include <memory>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <mutex>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+TEST(task_pool, enqueue_and_flush)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    for (auto i = 0u; i < 1000u; i++)
+    {
+        pool.enqueue([&] () {
+            count++;
+        });
+    }
+
+    pool.flush();
+    EXPECT_EQ(1000u, count);
+}
+
+TEST(task_pool, nested_enqueue)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    for (auto i = 0u; i < 16u; i++)
+    {
+        pool.enqueue([&] () {
+            for (auto j = 0u; j < 100u; j++)
+            {
+                pool.enqueue([&] () {
+                    count++;
+                });
+            }
+        });
+    }
+
+    pool.flush();
+    EXPECT_EQ(1600u, count);
+}
+
+TEST(task_pool, work_is_stolen)
+{
+    auto pool    = c9y::task_pool{4u};
+    auto mutex   = std::mutex{};
+    auto threads = std::set<std::thread::id>{};
+
+    // all sub tasks land in the local deque of one worker
+    pool.enqueue([&] () {
+        for (auto i = 0u; i < 64u; i++)
+        {
+            pool.enqueue([&] () {
+                std::this_thread::sleep_for(1ms);
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                threads.insert(std::this_thread::get_id());
+            });
+        }
+    });
+
+    pool.flush();
+    EXPECT_LT(1u, threads.size());
+}
+
+TEST(task_pool, enqueue_bulk)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    auto funcs = std::vector<std::function<void ()>>(100u, [&] () {
+        count++;
+    });
+    pool.enqueue_bulk(begin(funcs), end(funcs));
+
+    auto tasks = std::vector<c9y::task>{};
+    for (auto i = 0u; i < 100u; i++)
+    {
+        tasks.emplace_back([&, value = std::make_unique<unsigned int>(2u)] () {
+            count += *value;
+        });
+    }
+    pool.enqueue_bulk(std::make_move_iterator(begin(tasks)), std::make_move_iterator(end(tasks)));
+
+    pool.flush();
+    EXPECT_EQ(300u, count);
+}
+
+TEST(task_pool, enqueue_bulk_from_worker)
+{
+    auto pool  = c9y::task_pool{4u};
+    auto count = std::atomic<unsigned int>{0u};
+
+    pool.enqueue([&] () {
+        auto funcs = std::vector<std::function<void ()>>(100u, [&] () {
+            count++;
+        });
+        pool.enqueue_bulk(begin(funcs), end(funcs));
+    });
+
+    pool.flush();
+    EXPECT_EQ(100u, count);
+}
+
+TEST(task_pool, spin_before_park)
+{
+    // without spinning the worker would park, retire and be replaced
+    auto starts = std::atomic<unsigned int>{0u};
+    auto stops  = std::atomic<unsigned int>{0u};
+    auto pool   = c9y::task_pool{c9y::task_pool_options{
+        .concurency      = 1u,
+        .min_concurency  = 0u,
+        .idle_timeout    = 1ms,
+        .spin_duration   = 500ms,
+        .on_thread_start = [&] (size_t) {starts++;},
+        .on_thread_stop  = [&] (size_t) {stops++;}
+    }};
+    auto first  = std::promise<std::thread::id>{};
+    auto second = std::promise<std::thread::id>{};
+
+    pool.enqueue([&] () {
+        first.set_value(std::this_thread::get_id());
+    });
+    auto first_id = first.get_future().get();
+
+    // enqueued in the spin window, picked up by the awake worker
+    std::this_thread::sleep_for(10ms);
+    pool.enqueue([&] () {
+        second.set_value(std::this_thread::get_id());
+    });
+
+    EXPECT_EQ(first_id, second.get_future().get());
+    EXPECT_EQ(1u, starts);
+    EXPECT_EQ(0u, stops);
+}
+
+TEST(task_pool, hot_workers)
+{
+    auto hot_stops  = std::atomic<unsigned int>{0u};
+    auto cold_stops = std::atomic<unsigned int>{0u};
+    auto pool       = c9y::task_pool{c9y::task_pool_options{
+        .concurency     = 2u,
+        .min_concurency = 0u,
+        .idle_timeout   = 5ms,
+        .hot_workers    = 1u,
+        .on_thread_stop = [&] (size_t index) {
+            if (index < 1u)
+            {
+                hot_stops++;
+            }
+            else
+            {
+                cold_stops++;
+            }
+        }
+    }};
+
+    // keep both workers busy at once, so the pool grows to two threads
+    auto gate = std::promise<void>{};
+    pool.enqueue([&, f = gate.get_future()] () {
+        f.wait();
+    });
+    pool.enqueue([&] () {
+        gate.set_value();
+    });
+    pool.flush();
+
+    // idle for much longer than idle_timeout, the cold worker retires
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (cold_stops == 0u && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    std::this_thread::sleep_for(50ms);
+
+    EXPECT_EQ(1u, cold_stops);
+    EXPECT_EQ(0u, hot_stops);
+
+    // the hot worker is still there and picks up new work
+    auto index = std::promise<std::optional<size_t>>{};
+    pool.enqueue([&] () {
+        index.set_value(c9y::task_pool::worker_index());
+    });
+    EXPECT_EQ(std::optional<size_t>{0u}, index.get_future().get());
+}
+
+TEST(task_pool, priority_order)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto gate  = std::promise<void>{};
+    auto order = std::vector<c9y::priority>{};
+
+    pool.enqueue([&, f = gate.get_future()] () {
+        f.wait();
+    });
+
+    for (auto prio : {c9y::priority::background, c9y::priority::normal, c9y::priority::high})
+    {
+        pool.enqueue(prio, [&, prio] () {
+            order.push_back(prio);
+        });
+    }
+
+    gate.set_value();
+    pool.flush();
+
+    auto expected = std::vector<c9y::priority>{c9y::priority::high, c9y::priority::normal, c9y::priority::background};
+    EXPECT_EQ(expected, order);
+}
+
+TEST(task_pool, background_does_not_starve)
+{
+    auto pool  = c9y::task_pool{c9y::task_pool_options{.concurency = 1u, .starvation_limit = 4u}};
+    auto gate  = std::promise<void>{};
+    auto order = std::vector<c9y::priority>{};
+
+    pool.enqueue([&, f = gate.get_future()] () {
+        f.wait();
+    });
+
+    pool.enqueue(c9y::priority::background, [&] () {
+        order.push_back(c9y::priority::background);
+    });
+    for (auto i = 0u; i < 20u; i++)
+    {
+        pool.enqueue(c9y::priority::high, [&] () {
+            order.push_back(c9y::priority::high);
+        });
+    }
+
+    gate.set_value();
+    pool.flush();
+
+    auto pos = std::find(begin(order), end(order), c9y::priority::background) - begin(order);
+    EXPECT_GT(5, pos);
+}
+
+TEST(task_pool, run_until_helps)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto done  = std::promise<void>{};
+    auto count = std::atomic<unsigned int>{0u};
+
+    // the only worker waits for work it enqueued itself
+    pool.enqueue([&] () {
+        for (auto i = 0u; i < 10u; i++)
+        {
+            pool.enqueue([&] () {
+                count++;
+            });
+        }
+        EXPECT_TRUE(pool.is_worker());
+        pool.run_until([&] () {
+            return count == 10u;
+        });
+        done.set_value();
+    });
+
+    EXPECT_FALSE(pool.is_worker());
+    done.get_future().wait();
+    EXPECT_EQ(10u, count);
+}
+
+TEST(task_pool, elastic_grows)
+{
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency     = 4u,
+        .min_concurency = 0u
+    }};
+    EXPECT_EQ(0u, pool.get_concurency());
+
+    // the tasks block each other until all four run at once
+    auto count = std::atomic<unsigned int>{0u};
+    for (auto i = 0u; i < 4u; i++)
+    {
+        pool.enqueue([&] () {
+            count++;
+            while (count < 4u)
+            {
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    pool.flush();
+    EXPECT_EQ(4u, count);
+    EXPECT_EQ(4u, pool.get_concurency());
+}
+
+TEST(task_pool, elastic_shrinks)
+{
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency     = 4u,
+        .min_concurency = 1u,
+        .idle_timeout   = std::chrono::milliseconds(10)
+    }};
+    EXPECT_EQ(1u, pool.get_concurency());
+
+    auto count = std::atomic<unsigned int>{0u};
+    for (auto i = 0u; i < 4u; i++)
+    {
+        pool.enqueue([&] () {
+            count++;
+            while (count < 4u)
+            {
+                std::this_thread::yield();
+            }
+        });
+    }
+    pool.flush();
+    EXPECT_EQ(4u, pool.get_concurency());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.get_concurency() > 1u && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(1u, pool.get_concurency());
+
+    // the pool grows again on demand
+    auto done = std::atomic<unsigned int>{0u};
+    for (auto i = 0u; i < 10u; i++)
+    {
+        pool.enqueue([&] () {
+            done++;
+        });
+    }
+    pool.flush();
+    EXPECT_EQ(10u, done);
+}
+
+TEST(task_pool, elastic_stop_hook_enqueues)
+{
+    auto self = std::atomic<c9y::task_pool*>{nullptr};
+    auto once = std::atomic<bool>{false};
+    auto done = std::atomic<unsigned int>{0u};
+
+    // a retiring thread enqueues, which must spawn a replacement
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency     = 2u,
+        .min_concurency = 0u,
+        .idle_timeout   = std::chrono::milliseconds(5),
+        .on_thread_stop = [&] (size_t) {
+            auto p = self.load();
+            if (p && !once.exchange(true))
+            {
+                p->enqueue([&] () {
+                    done++;
+                });
+            }
+        }
+    }};
+    self = &pool;
+
+    pool.enqueue([&] () {
+        done++;
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done < 2u && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(2u, done);
+}
+
+TEST(task_pool, elastic_stop_hooks_enqueue_together)
+{
+    auto self    = std::atomic<c9y::task_pool*>{nullptr};
+    auto in_hook = std::atomic<unsigned int>{0u};
+    auto done    = std::atomic<unsigned int>{0u};
+
+    // two threads retire at once and both enqueue from their stop hooks,
+    // neither may wait for the other to exit
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency     = 2u,
+        .min_concurency = 0u,
+        .idle_timeout   = std::chrono::milliseconds(5),
+        .on_thread_stop = [&] (size_t) {
+            auto p = self.load();
+            if (p == nullptr || in_hook++ >= 2u)
+            {
+                return;
+            }
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (in_hook < 2u && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            p->enqueue([&] () {
+                done++;
+            });
+        }
+    }};
+    self = &pool;
+
+    // the first task waits for the second, so that both threads run
+    auto second = std::promise<void>{};
+    pool.enqueue([&, started = second.get_future()] () {
+        started.wait();
+        done++;
+    });
+    pool.enqueue([&] () {
+        second.set_value();
+        done++;
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done < 4u && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(4u, done);
+}
+
+TEST(task_pool, enqueue_after)
+{
+    auto pool  = c9y::task_pool{2u};
+    auto order = std::vector<unsigned int>{};
+    auto mutex = std::mutex{};
+    auto done  = std::promise<void>{};
+
+    auto start = std::chrono::steady_clock::now();
+    pool.enqueue_after(std::chrono::milliseconds(20), [&] () {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        order.push_back(2u);
+        done.set_value();
+    });
+    pool.enqueue_at(start + std::chrono::milliseconds(10), [&] () {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        order.push_back(1u);
+    });
+
+    done.get_future().wait();
+    EXPECT_LE(std::chrono::milliseconds(20), std::chrono::steady_clock::now() - start);
+    EXPECT_EQ((std::vector<unsigned int>{1u, 2u}), order);
+}
+
+TEST(task_pool, many_timers)
+{
+    auto pool  = c9y::task_pool{2u};
+    auto count = std::atomic<unsigned int>{0u};
+    auto now   = std::chrono::steady_clock::now();
+
+    for (auto i = 0u; i < 100000u; i++)
+    {
+        pool.enqueue_at(now + std::chrono::microseconds(i % 1000u), [&] () {
+            count++;
+        });
+    }
+
+    auto deadline = now + std::chrono::seconds(10);
+    while (count < 100000u && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(100000u, count);
+}
+
+TEST(task_pool, enqueue_every)
+{
+    auto pool   = c9y::task_pool{2u};
+    auto count  = std::atomic<unsigned int>{0u};
+    auto source = c9y::stop_source{};
+
+    pool.enqueue_every(std::chrono::milliseconds(1), [&] () {
+        count++;
+    }, source.get_token());
+
+    while (count < 5u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    source.request_stop();
+
+    // at most one run that was already scheduled may follow
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto stopped = count.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(stopped, count);
+}
+
+TEST(task_pool, enqueue_every_move_only)
+{
+    auto pool   = c9y::task_pool{2u};
+    auto count  = std::make_unique<std::atomic<unsigned int>>(0u);
+    auto done   = std::promise<void>{};
+    auto source = c9y::stop_source{};
+
+    // the callable owns it's state and is called again and again
+    pool.enqueue_every(std::chrono::milliseconds(1), [&done, &source, count = std::move(count)] () {
+        if (++*count == 3u)
+        {
+            source.request_stop();
+            done.set_value();
+        }
+    }, source.get_token());
+
+    done.get_future().wait();
+}
+
+TEST(task_pool, timers_dropped_on_destruction)
+{
+    auto count = std::atomic<unsigned int>{0u};
+    {
+        auto pool = c9y::task_pool{1u};
+        pool.enqueue_after(std::chrono::hours(1), [&] () {
+            count++;
+        });
+        pool.enqueue_every(std::chrono::milliseconds(1), [&] () {
+            count++;
+        });
+    }
+    auto stopped = count.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(stopped, count);
+}
+
+TEST(task_pool, cancelled_task_is_dropped)
+{
+    auto pool   = c9y::task_pool{1u};
+    auto count  = std::atomic<unsigned int>{0u};
+    auto gate   = std::promise<void>{};
+    auto source = c9y::stop_source{};
+
+    // block the only worker, so that the tasks can not start
+    auto blocked = gate.get_future().share();
+    pool.enqueue([blocked] () {
+        blocked.wait();
+    });
+
+    for (auto i = 0u; i < 10u; i++)
+    {
+        pool.enqueue(source.get_token(), [&] () {
+            count++;
+        });
+    }
+    pool.enqueue(c9y::priority::high, source.get_token(), [&] () {
+        count++;
+    });
+    pool.enqueue(c9y::stop_source{}.get_token(), [&] () {
+        count += 100u;
+    });
+
+    source.request_stop();
+    gate.set_value();
+    pool.flush();
+
+    EXPECT_EQ(100u, count);
+}
+
+TEST(task_pool, capacity)
+{
+    auto pool  = c9y::task_pool{c9y::task_pool_options{
+        .concurency = 1u,
+        .capacity   = 2u
+    }};
+    auto count   = std::atomic<unsigned int>{0u};
+    auto gate    = std::promise<void>{};
+    auto blocked = gate.get_future().share();
+    auto started = std::promise<void>{};
+
+    // block the only worker, the tasks from it are exempt from the capacity
+    pool.enqueue([&, blocked] () {
+        for (auto i = 0u; i < 5u; i++)
+        {
+            pool.enqueue([&] () {
+                count++;
+            });
+        }
+        started.set_value();
+        blocked.wait();
+    });
+    started.get_future().wait();
+
+    auto func = c9y::task{[&] () {
+        count++;
+    }};
+    EXPECT_FALSE(pool.try_enqueue(std::move(func)));
+    EXPECT_FALSE(pool.enqueue_for(std::chrono::milliseconds(10), std::move(func)));
+    EXPECT_TRUE(static_cast<bool>(func));
+
+    auto producer = std::thread{[&] () {
+        // blocks until the worker is released
+        pool.enqueue([&] () {
+            count++;
+        });
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    gate.set_value();
+    producer.join();
+
+    EXPECT_TRUE(pool.enqueue_for(std::chrono::seconds(10), std::move(func)));
+    pool.flush();
+    EXPECT_EQ(7u, count);
+}
+
+TEST(task_pool, thread_hooks)
+{
+    auto mutex   = std::mutex{};
+    auto started = std::set<size_t>{};
+    auto stopped = std::set<size_t>{};
+    {
+        auto pool = c9y::task_pool{c9y::task_pool_options{
+            .concurency      = 2u,
+            .on_thread_start = [&] (size_t index) {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                started.insert(index);
+            },
+            .on_thread_stop  = [&] (size_t index) {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                stopped.insert(index);
+            }
+        }};
+
+        auto indices = std::set<size_t>{};
+        for (auto i = 0u; i < 10u; i++)
+        {
+            pool.enqueue([&] () {
+                auto index = c9y::task_pool::worker_index();
+                ASSERT_TRUE(index.has_value());
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                indices.insert(*index);
+            });
+        }
+        pool.flush();
+
+        EXPECT_FALSE(c9y::task_pool::worker_index().has_value());
+        for (auto index : indices)
+        {
+            EXPECT_GT(2u, index);
+        }
+    }
+
+    EXPECT_EQ((std::set<size_t>{0u, 1u}), started);
+    EXPECT_EQ((std::set<size_t>{0u, 1u}), stopped);
+}
+
+TEST(task_pool, keyed_enqueue)
+{
+    auto pool    = c9y::task_pool{2u};
+    auto gate    = std::promise<void>{};
+    auto started = std::promise<size_t>{};
+    auto index   = std::atomic<size_t>{99u};
+
+    // block one worker, the keyed task must then run on the other, it's owner
+    auto blocked = gate.get_future().share();
+    pool.enqueue([&, blocked] () {
+        started.set_value(*c9y::task_pool::worker_index());
+        blocked.wait();
+    });
+    auto key = 1u - started.get_future().get();
+
+    pool.enqueue(size_t{key}, [&] () {
+        index = *c9y::task_pool::worker_index();
+    });
+
+    while (index == 99u)
+    {
+        std::this_thread::yield();
+    }
+    gate.set_value();
+    pool.flush();
+    EXPECT_EQ(key, index);
+}
+
+TEST(task_pool, keyed_enqueue_routing)
+{
+    auto pool = c9y::task_pool{4u};
+
+    auto run_keyed = [&] (size_t key) {
+        auto index = std::promise<size_t>{};
+        pool.enqueue(key, [&] () {
+            index.set_value(*c9y::task_pool::worker_index());
+        });
+        auto result = index.get_future().get();
+        pool.flush();
+        return result;
+    };
+
+    // while all workers are free, a key always runs on it's owner
+    auto owners = std::set<size_t>{};
+    for (auto key = size_t{0}; key < 8u; key++)
+    {
+        auto first = run_keyed(key);
+        for (auto i = 0; i < 4; i++)
+        {
+            EXPECT_EQ(first, run_keyed(key)) << "key " << key;
+        }
+        if (key < 4u)
+        {
+            owners.insert(first);
+        }
+    }
+    // and the keys are spread over the workers
+    EXPECT_EQ(4u, owners.size());
+}
+
+TEST(task_pool, keyed_enqueue_order)
+{
+    auto pool  = c9y::task_pool{1u};
+    auto order = std::vector<int>{};
+
+    // the keyed tasks wait until the enqueuing task finished
+    pool.enqueue([&] () {
+        for (auto i = 0; i < 10; i++)
+        {
+            pool.enqueue(size_t{0}, [&, i] () {
+                order.push_back(i);
+            });
+        }
+    });
+    pool.flush();
+
+    auto expected = std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    EXPECT_EQ(expected, order);
+}
+
+TEST(task_pool, lifo_slot_fairness)
+{
+    auto pool = c9y::task_pool{c9y::task_pool_options{
+        .concurency = 1u,
+        .lifo_limit = 4u
+    }};
+    auto order = std::vector<int>{};
+
+    // each link of the chain enqueues the next one
+    std::function<void (int)> chain = [&] (int i) {
+        order.push_back(i);
+        if (i < 10)
+        {
+            pool.enqueue([&, i] () {
+                chain(i + 1);
+            });
+        }
+    };
+
+    pool.enqueue([&] () {
+        pool.enqueue([&] () {
+            order.push_back(-1);
+        });
+        pool.enqueue([&] () {
+            chain(1);
+        });
+    });
+    pool.flush();
+
+    // the other task runs after lifo_limit links of the chain
+    auto pos = std::find(begin(order), end(order), -1) - begin(order);
+    EXPECT_EQ(4, pos);
+    EXPECT_EQ(11u, order.size());
+}
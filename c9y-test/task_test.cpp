@@ -0,0 +1,119 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <c9y/task.h>
+
+#include <memory>
+#include <future>
+#include <array>
+#include <gtest/gtest.h>
+
+TEST(task, empty)
+{
+    auto t = c9y::task{};
+    EXPECT_FALSE(t);
+    EXPECT_THROW(t(), std::bad_function_call);
+
+    auto f = std::function<void ()>{};
+    EXPECT_FALSE(c9y::task{f});
+}
+
+TEST(task, invoke)
+{
+    auto count = 0u;
+    auto t = c9y::task{[&] () {
+        count++;
+    }};
+
+    EXPECT_TRUE(t);
+    t();
+    t();
+    EXPECT_EQ(2u, count);
+}
+
+TEST(task, move_only_capture)
+{
+    auto value = std::make_unique<int>(42);
+    auto promise = std::promise<int>{};
+    auto future = promise.get_future();
+
+    auto t = c9y::task{[value = std::move(value), promise = std::move(promise)] () mutable {
+        promise.set_value(*value);
+    }};
+    t();
+
+    EXPECT_EQ(42, future.get());
+}
+
+TEST(task, move)
+{
+    auto count = 0u;
+    auto a = c9y::task{[&] () {
+        count++;
+    }};
+
+    auto b = std::move(a);
+    EXPECT_FALSE(a);
+    EXPECT_TRUE(b);
+    b();
+
+    a = std::move(b);
+    EXPECT_TRUE(a);
+    EXPECT_FALSE(b);
+    a();
+
+    EXPECT_EQ(2u, count);
+}
+
+TEST(task, large_capture)
+{
+    auto values = std::array<unsigned int, 64>{};
+    values.fill(1u);
+    static_assert(sizeof(values) > c9y::task::buffer_size);
+
+    auto sum = 0u;
+    auto a = c9y::task{[&sum, values] () {
+        for (auto v : values)
+        {
+            sum += v;
+        }
+    }};
+    auto b = std::move(a);
+    b();
+
+    EXPECT_EQ(64u, sum);
+}
+
+TEST(task, destroys_callable)
+{
+    auto value = std::make_shared<int>(42);
+    {
+        auto small = c9y::task{[value] () {}};
+        auto large = c9y::task{[value, padding = std::array<char, 128>{}] () {}};
+        EXPECT_EQ(3, value.use_count());
+
+        auto moved = std::move(small);
+        EXPECT_EQ(3, value.use_count());
+    }
+    EXPECT_EQ(1, value.use_count());
+}
@@ -84,3 +84,32 @@ TEST(thread_pool, stop_rquest)
 
     EXPECT_TRUE(pool.request_stop());
 }
+
+TEST(thread_pool, thread_hooks)
+{
+    auto started = std::atomic<unsigned int>{0};
+    auto stopped = std::atomic<unsigned int>{0};
+    auto indices = std::atomic<unsigned int>{0};
+
+    auto pool = c9y::thread_pool{[&] () {
+        // the start hook ran before the thread function
+        EXPECT_LT(0u, started.load());
+        auto index = c9y::thread_pool::thread_index();
+        ASSERT_TRUE(index.has_value());
+        indices |= 1u << *index;
+    }, c9y::thread_pool_options{
+        .concurency      = 3u,
+        .on_thread_start = [&] (size_t) {
+            started++;
+        },
+        .on_thread_stop  = [&] (size_t) {
+            stopped++;
+        }
+    }};
+    pool.join();
+
+    EXPECT_EQ(3u, started);
+    EXPECT_EQ(3u, stopped);
+    EXPECT_EQ(7u, indices);
+    EXPECT_FALSE(c9y::thread_pool::thread_index().has_value());
+}
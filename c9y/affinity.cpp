@@ -0,0 +1,311 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "affinity.h"
+
+#include <thread>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#ifdef WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace c9y
+{
+    namespace
+    {
+        #ifdef WINDOWS
+        constexpr size_t cpus_per_group = 64u;
+        #endif
+
+        // the CPUs the process may run on
+        std::vector<size_t> all_cpus() noexcept
+        {
+            auto result = std::vector<size_t>{};
+
+            #ifdef WINDOWS
+            auto process_mask = DWORD_PTR{0};
+            auto system_mask  = DWORD_PTR{0};
+            if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+            {
+                for (size_t i = 0; i < cpus_per_group; i++)
+                {
+                    if (process_mask & (DWORD_PTR{1} << i))
+                    {
+                        result.push_back(i);
+                    }
+                }
+            }
+            #elif defined(__linux__)
+            auto set = cpu_set_t{};
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                {
+                    if (CPU_ISSET(cpu, &set))
+                    {
+                        result.push_back(cpu);
+                    }
+                }
+            }
+            #endif
+
+            if (result.empty())
+            {
+                auto count = std::max(std::thread::hardware_concurrency(), 1u);
+                for (size_t i = 0; i < count; i++)
+                {
+                    result.push_back(i);
+                }
+            }
+            return result;
+        }
+
+        #ifdef __linux__
+        // parses lists like "0-3,8-11", as used for CPUs and nodes
+        std::vector<size_t> parse_cpu_list(const std::string& list)
+        {
+            auto result = std::vector<size_t>{};
+            auto pos    = size_t{0};
+            while (pos < list.size())
+            {
+                auto end   = list.find(',', pos);
+                auto range = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+                auto dash  = range.find('-');
+                if (!range.empty() && range[0] != '\n')
+                {
+                    auto first = std::stoul(range);
+                    auto last  = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                    for (auto cpu = first; cpu <= last; cpu++)
+                    {
+                        result.push_back(cpu);
+                    }
+                }
+                if (end == std::string::npos)
+                {
+                    break;
+                }
+                pos = end + 1;
+            }
+            return result;
+        }
+        #endif
+    }
+
+    size_t get_numa_node_count() noexcept
+    {
+        #ifdef WINDOWS
+        auto highest = ULONG{0};
+        if (GetNumaHighestNodeNumber(&highest))
+        {
+            return static_cast<size_t>(highest) + 1u;
+        }
+        return 1u;
+        #elif defined(__linux__)
+        // node numbers may have gaps, the count covers the highest online node
+        try
+        {
+            auto file = std::ifstream{"/sys/devices/system/node/online"};
+            auto list = std::string{};
+            if (std::getline(file, list))
+            {
+                auto nodes = parse_cpu_list(list);
+                if (!nodes.empty())
+                {
+                    return *std::max_element(begin(nodes), end(nodes)) + 1u;
+                }
+            }
+            return 1u;
+        }
+        catch (...)
+        {
+            return 1u;
+        }
+        #else
+        return 1u;
+        #endif
+    }
+
+    std::vector<size_t> get_numa_node_cpus(size_t node) noexcept
+    {
+        try
+        {
+            #ifdef WINDOWS
+            auto affinity = GROUP_AFFINITY{};
+            if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity))
+            {
+                auto result = std::vector<size_t>{};
+                for (size_t i = 0; i < cpus_per_group; i++)
+                {
+                    if (affinity.Mask & (KAFFINITY{1} << i))
+                    {
+                        result.push_back(affinity.Group * cpus_per_group + i);
+                    }
+                }
+                return result;
+            }
+            #elif defined(__linux__)
+            auto file = std::ifstream{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+            auto list = std::string{};
+            if (std::getline(file, list))
+            {
+                return parse_cpu_list(list);
+            }
+            #endif
+
+            return node == 0u ? all_cpus() : std::vector<size_t>{};
+        }
+        catch (...)
+        {
+            return {};
+        }
+    }
+
+    size_t get_numa_node(size_t cpu) noexcept
+    {
+        auto count = get_numa_node_count();
+        for (size_t node = 0; node < count; node++)
+        {
+            auto cpus = get_numa_node_cpus(node);
+            if (std::find(begin(cpus), end(cpus), cpu) != end(cpus))
+            {
+                return node;
+            }
+        }
+        return 0u;
+    }
+
+    std::optional<size_t> get_current_cpu() noexcept
+    {
+        #ifdef WINDOWS
+        auto number = PROCESSOR_NUMBER{};
+        GetCurrentProcessorNumberEx(&number);
+        return number.Group * cpus_per_group + number.Number;
+        #elif defined(__linux__)
+        auto cpu = sched_getcpu();
+        if (cpu < 0)
+        {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(cpu);
+        #else
+        return std::nullopt;
+        #endif
+    }
+
+    bool set_thread_affinity(size_t cpu) noexcept
+    {
+        #ifdef WINDOWS
+        auto affinity  = GROUP_AFFINITY{};
+        affinity.Group = static_cast<WORD>(cpu / cpus_per_group);
+        affinity.Mask  = KAFFINITY{1} << (cpu % cpus_per_group);
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+        #elif defined(__linux__)
+        if (cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        auto set = cpu_set_t{};
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+        #else
+        (void)cpu;
+        return false;
+        #endif
+    }
+
+    std::vector<size_t> get_placement_cpus(const thread_placement& placement, size_t concurency) noexcept
+    {
+        if (placement.cpus.empty() && !placement.spread_numa_nodes)
+        {
+            return {};
+        }
+
+        try
+        {
+            auto cpus = placement.cpus.empty() ? all_cpus() : placement.cpus;
+
+            if (placement.spread_numa_nodes)
+            {
+                // order the CPUs round robin by node, so that consecutive
+                // threads land on different nodes
+                auto node_count = get_numa_node_count();
+                auto nodes      = std::vector<std::vector<size_t>>(node_count);
+                for (size_t node = 0; node < node_count; node++)
+                {
+                    for (auto cpu : get_numa_node_cpus(node))
+                    {
+                        if (std::find(begin(cpus), end(cpus), cpu) != end(cpus))
+                        {
+                            nodes[node].push_back(cpu);
+                        }
+                    }
+                }
+
+                cpus.clear();
+                for (size_t i = 0; cpus.size() < concurency; i++)
+                {
+                    auto added = false;
+                    for (const auto& node : nodes)
+                    {
+                        if (i < node.size())
+                        {
+                            cpus.push_back(node[i]);
+                            added = true;
+                        }
+                    }
+                    if (!added)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (cpus.empty())
+            {
+                return {};
+            }
+
+            auto result = std::vector<size_t>(concurency);
+            for (size_t i = 0; i < concurency; i++)
+            {
+                result[i] = cpus[i % cpus.size()];
+            }
+            return result;
+        }
+        catch (...)
+        {
+            return {};
+        }
+    }
+}
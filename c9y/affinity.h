@@ -0,0 +1,80 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_AFFINITY_H_
+#define _C9Y_AFFINITY_H_
+
+#include <vector>
+#include <optional>
+
+#include "defines.h"
+
+namespace c9y
+{
+    //! Placement of the threads of a pool on the CPUs.
+    //!
+    //! By default threads are not pinned and the operating system is free to
+    //! migrate them. If cpus is set, each thread is pinned to one of the given
+    //! CPUs, in order. If spread_numa_nodes is set, the threads are pinned
+    //! round robin across the NUMA nodes, so that each node gets an equal
+    //! share of threads.
+    struct thread_placement
+    {
+        //! The CPUs to pin the threads to; if empty all CPUs the process may run on are used.
+        std::vector<size_t> cpus = {};
+
+        //! Distribute the threads across the NUMA nodes.
+        bool spread_numa_nodes = false;
+    };
+
+    //! Get the number of NUMA nodes.
+    //!
+    //! Nodes are numbered up to the highest online node; when the numbers
+    //! have gaps, the missing nodes have no CPUs. On systems without NUMA
+    //! or where it can not be determined, this is 1.
+    [[nodiscard]] C9Y_EXPORT size_t get_numa_node_count() noexcept;
+
+    //! Get the CPUs of a NUMA node.
+    [[nodiscard]] C9Y_EXPORT std::vector<size_t> get_numa_node_cpus(size_t node) noexcept;
+
+    //! Get the NUMA node a CPU belongs to.
+    [[nodiscard]] C9Y_EXPORT size_t get_numa_node(size_t cpu) noexcept;
+
+    //! Get the CPU the calling thread currently runs on.
+    [[nodiscard]] C9Y_EXPORT std::optional<size_t> get_current_cpu() noexcept;
+
+    //! Pin the calling thread to one CPU.
+    //!
+    //! @returns true if the operating system accepted the affinity.
+    C9Y_EXPORT bool set_thread_affinity(size_t cpu) noexcept;
+
+    //! Compute the CPU for each thread of a pool.
+    //!
+    //! @param placement the placement of the threads
+    //! @param concurency the number of threads
+    //!
+    //! @returns the CPU for each thread or an empty vector if the threads
+    //! are not pinned.
+    [[nodiscard]] C9Y_EXPORT std::vector<size_t> get_placement_cpus(const thread_placement& placement, size_t concurency) noexcept;
+}
+
+#endif
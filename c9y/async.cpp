@@ -29,9 +29,15 @@ using namespace std::literals::chrono_literals;
 
 namespace c9y
 {
-    void async(const std::function<void()>& func) noexcept
+    void async(task func) noexcept
     {
-        static task_pool pool(std::thread::hardware_concurrency());
-        pool.enqueue(func);
+        if (auto exec = get_current_executor())
+        {
+            exec->enqueue(std::move(func));
+            return;
+        }
+
+        static task_pool pool(task_pool_options{.min_concurency = 0u});
+        pool.enqueue(std::move(func));
     }
 }
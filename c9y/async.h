@@ -26,13 +26,27 @@
 #include <functional>
 
 #include "defines.h"
+#include "task.h"
+#include "executor.h"
 
 namespace c9y
 {
     //! Queue action to be executed on the shared thread pool.
     //!
+    //! If a scoped_executor is active on the calling thread, the action
+    //! is executed by it's executor instead.
+    //!
+    //! @param func the function to execute.
+    C9Y_EXPORT void async(task func) noexcept;
+
+    //! Queue action to be executed on an executor.
+    //!
+    //! @param exec the executor that runs the action.
     //! @param func the function to execute.
-    C9Y_EXPORT void async(const std::function<void ()>& func) noexcept;
+    inline void async(executor& exec, task func) noexcept
+    {
+        exec.enqueue(std::move(func));
+    }
 
     template <typename T> using AsyncFunc = T (*) ();
 
@@ -41,12 +55,28 @@ namespace c9y
     //! @param func the function to execute.
     //! @returns future that with the resulting value.
     template <typename T, typename Func = AsyncFunc<T>>
-    [[nodiscard]] std::future<T> async(const Func& func) noexcept
+    [[nodiscard]] std::future<T> async(Func&& func) noexcept
+    {
+        auto ptask  = std::packaged_task<T()>(std::forward<Func>(func));
+        auto future = ptask.get_future();
+        async([ptask = std::move(ptask)] () mutable {
+            ptask();
+        });
+        return future;
+    }
+
+    //! Queue action to be executed on an executor with result
+    //!
+    //! @param exec the executor that runs the action.
+    //! @param func the function to execute.
+    //! @returns future that with the resulting value.
+    template <typename T, typename Func = AsyncFunc<T>>
+    [[nodiscard]] std::future<T> async(executor& exec, Func&& func) noexcept
     {
-        auto task = std::make_shared<std::packaged_task<T()>>(func);
-        auto future = task->get_future();
-        async([task] () mutable {
-            (*task)();
+        auto ptask  = std::packaged_task<T()>(std::forward<Func>(func));
+        auto future = ptask.get_future();
+        exec.enqueue([ptask = std::move(ptask)] () mutable {
+            ptask();
         });
         return future;
     }
@@ -29,6 +29,9 @@
 #include <mutex>
 #include <condition_variable>
 
+#include "fiber.h"
+#include "waiter.h"
+
 namespace c9y
 {
     struct arrival_token
@@ -69,6 +72,11 @@ namespace c9y
             }
 
             auto this_iteration = iteration;
+            if (fiber::current())
+            {
+                fibers.wait(lock, [&]{return this_iteration != iteration;});
+                return;
+            }
             cond.wait(lock, [&]{return this_iteration != iteration;});
         }
 
@@ -90,6 +98,7 @@ namespace c9y
 
         mutable std::mutex              mutex;
         mutable std::condition_variable cond;
+        mutable _wait_list              fibers;
 
         arrival_token do_ardive(std::ptrdiff_t n, std::ptrdiff_t drop = 0) noexcept
         {
@@ -109,6 +118,7 @@ namespace c9y
             count = expected;
             iteration++;
             cond.notify_all();
+            fibers.notify_all();
 
             return at;
         }
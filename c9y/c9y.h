@@ -23,14 +23,24 @@
 #define _C9Y_H_
 
 #include "defines.h"
+#include "affinity.h"
 #include "async.h"
 #include "coroutine.h"
 #include "exceptions.h"
+#include "executor.h"
+#include "fiber.h"
 #include "jthread.h"
 #include "latch.h"
+#include "mpmc_queue.h"
 #include "parallel.h"
+#include "priority_queue.h"
 #include "queue.h"
+#include "select.h"
+#include "spsc_queue.h"
+#include "strand.h"
 #include "sync.h"
+#include "task.h"
+#include "task_group.h"
 #include "task_pool.h"
 #include "thread_pool.h"
 #include "utils.h"
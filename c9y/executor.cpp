@@ -0,0 +1,266 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "executor.h"
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "exceptions.h"
+#include "fiber.h"
+
+using namespace std::literals::chrono_literals;
+
+namespace c9y
+{
+    namespace
+    {
+        thread_local executor* current_executor = nullptr;
+
+        //! The longest time run_until waits before checking it's condition again.
+        constexpr auto max_executor_wait = 1ms;
+
+        void run_task(task& func) noexcept
+        {
+            try
+            {
+                func();
+            }
+            catch (...)
+            {
+                unhandled_exception();
+            }
+        }
+    }
+
+    void executor::enqueue_bulk(std::vector<task>& tasks) noexcept
+    {
+        for (auto& func : tasks)
+        {
+            enqueue(std::move(func));
+        }
+    }
+
+    bool executor::is_worker() const noexcept
+    {
+        return false;
+    }
+
+    void executor::run_until(const std::function<bool ()>& done) noexcept
+    {
+        if (fiber::current())
+        {
+            // the fiber parks and frees the worker until notify_run_until
+            while (true)
+            {
+                auto epoch = run_epoch.load();
+                if (done())
+                {
+                    return;
+                }
+
+                auto lock = std::unique_lock<std::mutex>{run_mutex};
+                run_waiting++;
+                run_fibers.wait(lock, [&] {return run_epoch != epoch;});
+                run_waiting--;
+            }
+        }
+
+        auto wait_time = std::chrono::microseconds(10);
+        while (true)
+        {
+            // a notification after this point is not lost
+            auto epoch = run_epoch.load();
+            if (done())
+            {
+                return;
+            }
+
+            auto lock = std::unique_lock<std::mutex>{run_mutex};
+            run_waiting++;
+            run_cond.wait_for(lock, wait_time, [&] {return run_epoch != epoch;});
+            run_waiting--;
+            wait_time = std::min<std::chrono::microseconds>(wait_time * 2, max_executor_wait);
+        }
+    }
+
+    void executor::notify_run_until() noexcept
+    {
+        run_epoch++;
+        if (run_waiting != 0)
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{run_mutex};
+                run_fibers.notify_all();
+            }
+            run_cond.notify_all();
+        }
+    }
+
+    void inline_executor::enqueue(task func) noexcept
+    {
+        run_task(func);
+    }
+
+    bool inline_executor::is_worker() const noexcept
+    {
+        // every thread executes it's own tasks
+        return true;
+    }
+
+    thread_executor::thread_executor() noexcept
+    : thread([this] () {thread_func();}) {}
+
+    thread_executor::~thread_executor()
+    {
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            stopped = true;
+        }
+        cond.notify_all();
+
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    void thread_executor::enqueue(task func) noexcept
+    {
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            tasks.push_back(std::move(func));
+        }
+        cond.notify_all();
+    }
+
+    void thread_executor::enqueue_bulk(std::vector<task>& bulk) noexcept
+    {
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            for (auto& func : bulk)
+            {
+                tasks.push_back(std::move(func));
+            }
+        }
+        cond.notify_all();
+    }
+
+    bool thread_executor::is_worker() const noexcept
+    {
+        return thread.get_id() == std::this_thread::get_id();
+    }
+
+    void thread_executor::run_until(const std::function<bool ()>& done) noexcept
+    {
+        if (!is_worker())
+        {
+            executor::run_until(done);
+            return;
+        }
+
+        auto wait_time = std::chrono::microseconds(10);
+        while (true)
+        {
+            auto epoch = run_epoch.load();
+            if (done())
+            {
+                return;
+            }
+
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            if (auto func = next_task(lock))
+            {
+                lock.unlock();
+                run_task(func);
+                wait_time = std::chrono::microseconds(10);
+                continue;
+            }
+
+            cond.wait_for(lock, wait_time, [&] {return !tasks.empty() || run_epoch != epoch;});
+            wait_time = std::min<std::chrono::microseconds>(wait_time * 2, max_executor_wait);
+        }
+    }
+
+    void thread_executor::notify_run_until() noexcept
+    {
+        executor::notify_run_until();
+
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            run_epoch++;
+        }
+        cond.notify_all();
+    }
+
+    task thread_executor::next_task(std::unique_lock<std::mutex>&) noexcept
+    {
+        if (tasks.empty())
+        {
+            return nullptr;
+        }
+
+        auto func = std::move(tasks.front());
+        tasks.pop_front();
+        return func;
+    }
+
+    void thread_executor::thread_func() noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        while (true)
+        {
+            if (auto func = next_task(lock))
+            {
+                lock.unlock();
+                run_task(func);
+                lock.lock();
+                continue;
+            }
+
+            if (stopped)
+            {
+                break;
+            }
+
+            cond.wait(lock, [&] {return stopped || !tasks.empty();});
+        }
+    }
+
+    executor* get_current_executor() noexcept
+    {
+        return current_executor;
+    }
+
+    scoped_executor::scoped_executor(executor& exec) noexcept
+    : previous(current_executor)
+    {
+        current_executor = &exec;
+    }
+
+    scoped_executor::~scoped_executor()
+    {
+        current_executor = previous;
+    }
+}
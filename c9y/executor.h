@@ -0,0 +1,160 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_EXECUTOR_H_
+#define _C9Y_EXECUTOR_H_
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "defines.h"
+#include "jthread.h"
+#include "task.h"
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Executor
+    //!
+    //! An executor runs tasks on some execution context. The parallel
+    //! algorithms and async take an executor as optional first argument,
+    //! so that callers can choose where their work runs.
+    //!
+    //! @see task_pool, inline_executor, thread_executor
+    class C9Y_EXPORT executor
+    {
+    public:
+        virtual ~executor() = default;
+
+        //! Add a task to the executor.
+        //!
+        //! @param func the task to execute
+        virtual void enqueue(task func) noexcept = 0;
+
+        //! Add a batch of tasks to the executor.
+        //!
+        //! The tasks are moved out of the vector. By default each task is
+        //! enqueued individually.
+        //!
+        //! @param tasks the tasks to execute
+        virtual void enqueue_bulk(std::vector<task>& tasks) noexcept;
+
+        //! Check if the calling thread executes tasks of this executor.
+        [[nodiscard]] virtual bool is_worker() const noexcept;
+
+        //! Wait until a condition is met.
+        //!
+        //! If the calling thread executes tasks of this executor, pending
+        //! tasks are executed while waiting. By default the thread only
+        //! waits for done.
+        //!
+        //! The condition is checked again when notify_run_until is called.
+        //! Conditions that nobody signals are still checked periodically,
+        //! but with a delay of up to a millisecond. A fiber parks until
+        //! notify_run_until is called, so its condition must be signalled.
+        //!
+        //! @param done the condition to wait for
+        virtual void run_until(const std::function<bool ()>& done) noexcept;
+
+        //! Wake the threads waiting in run_until.
+        //!
+        //! Call this after changing the state a run_until condition depends
+        //! on, so that the waiting threads check their condition right away.
+        virtual void notify_run_until() noexcept;
+
+    private:
+        std::mutex              run_mutex;
+        std::condition_variable run_cond;
+        _wait_list              run_fibers;
+        std::atomic<size_t>     run_epoch   = 0u;
+        std::atomic<size_t>     run_waiting = 0u;
+    };
+
+    //! Executor that runs tasks immediately on the calling thread.
+    class C9Y_EXPORT inline_executor : public executor
+    {
+    public:
+        void enqueue(task func) noexcept override;
+        [[nodiscard]] bool is_worker() const noexcept override;
+    };
+
+    //! Executor that runs tasks one after the other on a dedicated thread.
+    //!
+    //! Tasks that are pending when the executor is destroyed are executed
+    //! before the thread terminates.
+    class C9Y_EXPORT thread_executor : public executor
+    {
+    public:
+        thread_executor() noexcept;
+        ~thread_executor();
+
+        void enqueue(task func) noexcept override;
+        void enqueue_bulk(std::vector<task>& tasks) noexcept override;
+        [[nodiscard]] bool is_worker() const noexcept override;
+        void run_until(const std::function<bool ()>& done) noexcept override;
+        void notify_run_until() noexcept override;
+
+    private:
+        std::mutex              mutex;
+        std::condition_variable cond;
+        std::deque<task>        tasks;
+        bool                    stopped = false;
+        std::atomic<size_t>     run_epoch = 0u;
+        jthread                 thread;
+
+        void thread_func() noexcept;
+        [[nodiscard]] task next_task(std::unique_lock<std::mutex>& lock) noexcept;
+
+        thread_executor(const thread_executor&) = delete;
+        thread_executor& operator = (const thread_executor&) = delete;
+    };
+
+    //! Get the executor that overrides the default executors on this thread.
+    //!
+    //! @returns the executor of the innermost scoped_executor or nullptr
+    [[nodiscard]] C9Y_EXPORT executor* get_current_executor() noexcept;
+
+    //! Override the default executor on this thread.
+    //!
+    //! While a scoped_executor exists, async and the parallel algorithms
+    //! that are called without executor on this thread use the given
+    //! executor. Scopes can be nested; the previous executor is restored on
+    //! destruction.
+    class C9Y_EXPORT scoped_executor
+    {
+    public:
+        explicit scoped_executor(executor& exec) noexcept;
+        ~scoped_executor();
+
+    private:
+        executor* previous;
+
+        scoped_executor(const scoped_executor&) = delete;
+        scoped_executor& operator = (const scoped_executor&) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,330 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "fiber.h"
+
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "exceptions.h"
+
+#ifdef WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define C9Y_WINDOWS_FIBER
+#elif __has_include(<ucontext.h>) && __has_include(<sys/mman.h>)
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define C9Y_UCONTEXT_FIBER
+#endif
+
+// The fiber may be resumed on an other thread, so the thread local current
+// fiber must not be cached across a switch; keep it's accessors out of line.
+#if defined(_MSC_VER)
+#define C9Y_NOINLINE __declspec(noinline)
+#else
+#define C9Y_NOINLINE __attribute__((noinline))
+#endif
+
+using namespace std::literals::chrono_literals;
+
+namespace c9y
+{
+    namespace
+    {
+        thread_local fiber* current_fiber = nullptr;
+
+        //! The first delay of a waiting fiber.
+        constexpr auto min_fiber_wait = 10us;
+
+        //! The longest delay of a waiting fiber.
+        constexpr auto max_fiber_wait = 1000us;
+    }
+
+    #if defined(C9Y_WINDOWS_FIBER)
+    struct fiber::context
+    {
+        LPVOID handle = nullptr;
+        LPVOID caller = nullptr;
+
+        static VOID CALLBACK entry(LPVOID param)
+        {
+            auto self = static_cast<fiber*>(param);
+            self->run();
+        }
+
+        context(fiber* self, size_t stack_size)
+        {
+            handle = CreateFiber(stack_size, &context::entry, self);
+            if (handle == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        ~context()
+        {
+            DeleteFiber(handle);
+        }
+
+        void switch_in() noexcept
+        {
+            thread_local auto thread_fiber = LPVOID{nullptr};
+            if (thread_fiber == nullptr)
+            {
+                thread_fiber = ConvertThreadToFiber(nullptr);
+                if (thread_fiber == nullptr)
+                {
+                    // the thread is already a fiber
+                    thread_fiber = GetCurrentFiber();
+                }
+            }
+
+            caller = GetCurrentFiber();
+            SwitchToFiber(handle);
+        }
+
+        void switch_out() noexcept
+        {
+            SwitchToFiber(caller);
+        }
+    };
+    #elif defined(C9Y_UCONTEXT_FIBER)
+    struct fiber::context
+    {
+        ucontext_t self   = {};
+        ucontext_t caller = {};
+        void*      stack  = nullptr;
+        size_t     size   = 0u;
+
+        // makecontext only passes int arguments, so the pointer is split
+        static void entry(unsigned int hi, unsigned int lo)
+        {
+            auto ptr = (static_cast<std::uintptr_t>(hi) << 32) | static_cast<std::uintptr_t>(lo);
+            reinterpret_cast<fiber*>(ptr)->run();
+        }
+
+        context(fiber* f, size_t stack_size)
+        {
+            // the lowest page stays inaccessible, so that a stack overflow faults
+            auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size  = (stack_size + page - 1u) / page * page + page;
+            stack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (stack == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            mprotect(stack, page, PROT_NONE);
+
+            getcontext(&self);
+            self.uc_stack.ss_sp   = stack;
+            self.uc_stack.ss_size = size;
+            self.uc_link          = &caller;
+
+            auto ptr = reinterpret_cast<std::uintptr_t>(f);
+            makecontext(&self, reinterpret_cast<void (*)()>(&context::entry), 2,
+                        static_cast<unsigned int>(ptr >> 32), static_cast<unsigned int>(ptr & 0xffffffffu));
+        }
+
+        ~context()
+        {
+            munmap(stack, size);
+        }
+
+        void switch_in() noexcept
+        {
+            swapcontext(&caller, &self);
+        }
+
+        void switch_out() noexcept
+        {
+            swapcontext(&self, &caller);
+        }
+    };
+    #else
+    struct fiber::context
+    {
+        fiber* self;
+
+        context(fiber* f, size_t)
+        : self(f) {}
+
+        void switch_in() noexcept
+        {
+            // without fiber support the task runs to completion in place
+            self->run();
+        }
+
+        void switch_out() noexcept {}
+    };
+    #endif
+
+    fiber::fiber(task f, size_t stack_size)
+    : func(std::move(f)), ctx(std::make_unique<context>(this, stack_size)) {}
+
+    fiber::~fiber() = default;
+
+    bool fiber::resume() noexcept
+    {
+        if (finished)
+        {
+            return true;
+        }
+
+        parked = false;
+
+        auto previous = current_fiber;
+        current_fiber = this;
+        ctx->switch_in();
+        current_fiber = previous;
+
+        return finished;
+    }
+
+    bool fiber::done() const noexcept
+    {
+        return finished;
+    }
+
+    std::chrono::microseconds fiber::get_delay() const noexcept
+    {
+        return delay;
+    }
+
+    bool fiber::is_parked() const noexcept
+    {
+        return parked;
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> fiber::get_deadline() const noexcept
+    {
+        return deadline;
+    }
+
+    void fiber::on_wake(task resume) noexcept
+    {
+        {
+            auto lock = std::unique_lock<std::mutex>{wake_mutex};
+            if (!woken)
+            {
+                resumer = std::move(resume);
+                return;
+            }
+            woken = false;
+        }
+        // the wake came while the fiber was parking
+        resume();
+    }
+
+    void fiber::wake() noexcept
+    {
+        auto resume = task{};
+        {
+            auto lock = std::unique_lock<std::mutex>{wake_mutex};
+            if (!resumer)
+            {
+                woken = true;
+                return;
+            }
+            resume = std::move(resumer);
+            resumer = nullptr;
+        }
+        resume();
+    }
+
+    C9Y_NOINLINE fiber* fiber::current() noexcept
+    {
+        #if defined(C9Y_WINDOWS_FIBER) || defined(C9Y_UCONTEXT_FIBER)
+        return current_fiber;
+        #else
+        // the task runs on the thread's stack and can not suspend
+        return nullptr;
+        #endif
+    }
+
+    C9Y_NOINLINE void fiber::suspend(std::chrono::microseconds d) noexcept
+    {
+        auto self = current();
+        if (self == nullptr)
+        {
+            std::this_thread::sleep_for(d);
+            return;
+        }
+
+        self->delay = d;
+        self->ctx->switch_out();
+    }
+
+    C9Y_NOINLINE void fiber::park(std::optional<std::chrono::steady_clock::time_point> d) noexcept
+    {
+        auto self = current();
+        if (self == nullptr)
+        {
+            // only fibers park, threads wait on a condition
+            return;
+        }
+
+        self->parked   = true;
+        self->deadline = d;
+        self->ctx->switch_out();
+    }
+
+    void fiber::run() noexcept
+    {
+        try
+        {
+            func();
+        }
+        catch (...)
+        {
+            unhandled_exception();
+        }
+
+        // release the captures while the stack still exists
+        func     = nullptr;
+        delay    = std::chrono::microseconds(0);
+        finished = true;
+        ctx->switch_out();
+    }
+
+    bool fiber_wait(const std::function<bool ()>& ready, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+    {
+        auto wait_time = std::chrono::microseconds(min_fiber_wait);
+        while (!ready())
+        {
+            if (deadline && std::chrono::steady_clock::now() >= *deadline)
+            {
+                return false;
+            }
+
+            fiber::suspend(wait_time);
+            wait_time = std::min<std::chrono::microseconds>(wait_time * 2, max_fiber_wait);
+        }
+        return true;
+    }
+}
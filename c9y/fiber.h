@@ -0,0 +1,159 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_FIBER_H_
+#define _C9Y_FIBER_H_
+
+#include "defines.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <functional>
+
+#include "task.h"
+
+namespace c9y
+{
+    //! Fiber
+    //!
+    //! A fiber runs a task on it's own small stack. The task can suspend
+    //! itself and is later resumed where it left off, possibly on an other
+    //! thread. Fibers are scheduled by task_pool::enqueue_fiber.
+    //!
+    //! On Windows fibers use the native fiber API, elsewhere ucontext. Where
+    //! neither is available, a fiber runs it's task to completion on the
+    //! stack of the thread that resumes it.
+    //!
+    //! @warning Do not hold the address of a thread_local variable across a
+    //! call that may suspend the fiber, since the fiber may be resumed on an
+    //! other thread.
+    class C9Y_EXPORT fiber
+    {
+    public:
+        //! The default size of a fiber's stack.
+        static constexpr size_t default_stack_size = 64u * 1024u;
+
+        //! Create a fiber.
+        //!
+        //! @param func the task to run on the fiber
+        //! @param stack_size the size of the fiber's stack
+        explicit fiber(task func, size_t stack_size = default_stack_size);
+
+        //! Destructor
+        //!
+        //! Destroying a suspended fiber frees it's stack, without unwinding it.
+        ~fiber();
+
+        //! Run the fiber until it finishes or suspends.
+        //!
+        //! @returns true if the fiber finished
+        bool resume() noexcept;
+
+        //! Check if the fiber finished.
+        [[nodiscard]] bool done() const noexcept;
+
+        //! Get the delay the fiber requested when it suspended.
+        [[nodiscard]] std::chrono::microseconds get_delay() const noexcept;
+
+        //! Check if the fiber parked, instead of suspending for a delay.
+        [[nodiscard]] bool is_parked() const noexcept;
+
+        //! Get the deadline the fiber passed to park.
+        [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> get_deadline() const noexcept;
+
+        //! Set the task that resumes the parked fiber.
+        //!
+        //! The task runs once, when wake is called. If wake was already
+        //! called since the fiber parked, the task runs right away.
+        //!
+        //! @param resume the task that schedules the fiber again
+        void on_wake(task resume) noexcept;
+
+        //! Wake the fiber.
+        //!
+        //! If the fiber is parked, this runs the task set with on_wake.
+        //! Otherwise the next park of the fiber returns right away.
+        void wake() noexcept;
+
+        //! Get the fiber running on the calling thread.
+        //!
+        //! @returns the current fiber or nullptr if not called from a fiber
+        [[nodiscard]] static fiber* current() noexcept;
+
+        //! Suspend the current fiber.
+        //!
+        //! Control returns to the caller of resume, which should resume the
+        //! fiber again after the delay.
+        //!
+        //! @param delay the time after which the fiber wants to be resumed
+        static void suspend(std::chrono::microseconds delay = std::chrono::microseconds(0)) noexcept;
+
+        //! Park the current fiber until it is woken.
+        //!
+        //! Control returns to the caller of resume, which should resume the
+        //! fiber when wake is called, see on_wake. The fiber must be
+        //! registered where it's waker finds it before calling this.
+        //!
+        //! @param deadline the time after which the fiber wants to be resumed anyway
+        static void park(std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt) noexcept;
+
+    private:
+        struct context;
+
+        task                      func;
+        std::unique_ptr<context>  ctx;
+        bool                      finished = false;
+        bool                      parked   = false;
+        std::chrono::microseconds delay    = std::chrono::microseconds(0);
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+
+        std::mutex                wake_mutex;
+        task                      resumer;
+        bool                      woken    = false;
+
+        void run() noexcept;
+
+        fiber(const fiber&) = delete;
+        fiber& operator = (const fiber&) = delete;
+
+    friend struct context;
+    };
+
+    //! Wait for a condition without blocking the thread.
+    //!
+    //! When called from a fiber, the fiber suspends itself and checks the
+    //! condition again when it is resumed, with a growing delay. The worker
+    //! meanwhile executes other tasks. Outside of a fiber the calling thread
+    //! sleeps between the checks.
+    //!
+    //! The c9y primitives and run_until park the fiber until they signal it
+    //! instead; this is only for conditions that nobody signals.
+    //!
+    //! @param ready the condition to wait for
+    //! @param deadline the time after which to give up
+    //! @returns the result of the last check of ready
+    C9Y_EXPORT bool fiber_wait(const std::function<bool ()>& ready, std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt) noexcept;
+}
+
+#endif
@@ -22,10 +22,11 @@
 //
 
 #include "latch.h"
-
-#ifndef C9Y_USE_STD_LATCH
+#include "fiber.h"
 
 #include <cassert>
+#include <limits>
+
 namespace c9y
 {
     std::ptrdiff_t latch::max() noexcept
@@ -43,14 +44,32 @@ namespace c9y
         if (count <= 0)
         {
             cond.notify_all();
+            fibers.notify_all();
         }
     }
 
+    bool latch::try_wait() const noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        return count <= 0;
+    }
+
     void latch::wait() const
     {
         auto lock = std::unique_lock<std::mutex>{mutex};
+        if (fiber::current())
+        {
+            fibers.wait(lock, [&]{return count <= 0;});
+            return;
+        }
+
         cond.wait(lock, [&]{return count <= 0;});
         assert(count <= 0);
     }
+
+    void latch::arrive_and_wait(std::ptrdiff_t n)
+    {
+        count_down(n);
+        wait();
+    }
 }
-#endif
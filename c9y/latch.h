@@ -25,31 +25,20 @@
 #include "defines.h"
 
 #include <cstddef>
-
-#if defined __cpp_lib_latch && defined _MSC_VER
-#define C9Y_USE_STD_LATCH 1
-#endif
-
-#ifdef C9Y_USE_STD_LATCH
-#include <latch>
-#else
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
 
+#include "waiter.h"
+
 #ifdef max
 #warning "Undefined max. Defining the max macro will result in a compile error."
 #undef max
 #endif
-#endif
 
 
 namespace c9y
 {
-    #ifdef C9Y_USE_STD_LATCH
-    using latch = std::latch;
-    #else
-
     //! latch
     //!
     //! The latch class is a downward counter of type ptrdiff_t which can be used to synchronize threads.
@@ -57,6 +46,8 @@ namespace c9y
     //! is decremented to zero. There is no possibility to increase or reset the counter, which makes the
     //! latch a single-use barrier.
     //! Concurrent invocations of the member functions of latch, except for the destructor, do not introduce data races.
+    //!
+    //! Unlike std::latch, a fiber that waits on the latch parks and frees it's worker.
     class C9Y_EXPORT latch
     {
     public:
@@ -85,18 +76,24 @@ namespace c9y
             return count == 0;
         }
 
+        //! Returns true only if the internal counter has reached zero.
+        [[nodiscard]] bool try_wait() const noexcept;
+
         //! Blocks the calling thread until the internal counter reaches 0. If it is zero already, returns immediately.
         void wait() const;
 
+        //! Atomically decrements the internal counter by n and blocks until it reaches 0.
+        void arrive_and_wait(std::ptrdiff_t n = 1);
+
     private:
         std::ptrdiff_t                  count;
         mutable std::mutex              mutex;
         mutable std::condition_variable cond;
+        mutable _wait_list              fibers;
 
         latch(const latch&) = delete;
         latch& operator = (const latch&) = delete;
     };
-    #endif
 }
 
 #endif
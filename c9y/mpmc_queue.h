@@ -0,0 +1,301 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_MPMC_QUEUE_H_
+#define _C9Y_MPMC_QUEUE_H_
+
+#include "defines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+
+#include "utils.h"
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Bounded Lock-Free Multi Producer Multi Consumer Queue
+    //!
+    //! The mpmc_queue is a fixed capacity ring buffer where every slot carries
+    //! a sequence number. Producers and consumers claim slots with a single
+    //! compare and swap on their respective index, so push and pop never take
+    //! a lock while the queue is neither empty nor full.
+    //!
+    //! The interface mirrors queue, so one can be exchanged for the other.
+    //! The blocking calls only park once the queue is actually empty (or
+    //! full for push); the other side only touches the mutex when it knows
+    //! somebody is parked.
+    //!
+    //! @note The constructors of value_type used by push and emplace must not
+    //! throw, as a claimed slot can not be given back.
+    template <typename T>
+    class mpmc_queue
+    {
+    public:
+        using value_type = T;
+        using size_type  = size_t;
+
+        //! Create an empty queue.
+        //!
+        //! @param capacity the maximum number of values, rounded up to the
+        //! next power of two
+        explicit mpmc_queue(size_type capacity)
+        : mask(std::bit_ceil(std::max<size_type>(capacity, 2u)) - 1u),
+          cells(std::make_unique<cell[]>(mask + 1u))
+        {
+            for (auto i = size_type{0u}; i <= mask; i++)
+            {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        //! Destructor
+        //!
+        //! Destroys any value still in the queue.
+        ~mpmc_queue()
+        {
+            while (pop())
+            {
+            }
+        }
+
+        //! The maximum number of values the queue can hold.
+        size_type capacity() const noexcept
+        {
+            return mask + 1u;
+        }
+
+        //! Push a value onto the queue.
+        //!
+        //! This method will push the value onto the queue and wake up a thread
+        //! that is wating in pop_wait. If the queue is full, it waits until a
+        //! value is poped or the queue is stopped.
+        //!
+        //! @param value the value to push onto the queue
+        //! @return false if the queue was stopped while full
+        //!
+        //! @{
+        bool push(const value_type& value) noexcept
+        {
+            return emplace(value);
+        }
+
+        bool push(value_type&& value) noexcept
+        {
+            return emplace(std::move(value));
+        }
+
+        template <typename... Args>
+        bool emplace(Args&&... args) noexcept
+        {
+            // args are only forwarded once a slot is claimed
+            auto done = not_full.wait([&] () {
+                return claim_push(std::forward<Args>(args)...);
+            }, stopped, std::nullopt);
+            if (done)
+            {
+                not_empty.notify();
+            }
+            return done;
+        }
+        //! @}
+
+        //! Try to push a value onto the queue.
+        //!
+        //! @param value the value to push onto the queue
+        //! @return false if the queue is full and the value was not pushed
+        //!
+        //! @{
+        [[nodiscard]] bool try_push(const value_type& value) noexcept
+        {
+            return try_emplace(value);
+        }
+
+        [[nodiscard]] bool try_push(value_type&& value) noexcept
+        {
+            return try_emplace(std::move(value));
+        }
+
+        template <typename... Args>
+        [[nodiscard]] bool try_emplace(Args&&... args) noexcept
+        {
+            if (!claim_push(std::forward<Args>(args)...))
+            {
+                return false;
+            }
+            not_empty.notify();
+            return true;
+        }
+        //! @}
+
+        //! Pop a value of the queue.
+        //!
+        //! This method will try to pop a value off the queue. If no value is
+        //! in the queue, it will return nullopt.
+        [[nodiscard]] std::optional<value_type> pop() noexcept
+        {
+            auto value = claim_pop();
+            if (value)
+            {
+                not_full.notify();
+            }
+            return value;
+        }
+
+        //! Pop a value of the queue, wait if nessesary.
+        //!
+        //! This method will try to pop a value off the queue. If no value is
+        //! in the queue, it will wait until either a value is pushed onto the
+        //! queue or stop is called.
+        [[nodiscard]] std::optional<value_type> pop_wait() noexcept
+        {
+            return pop_until(std::nullopt);
+        }
+
+        //! Pop a value of the queue, wait for a defined duration if nessesary.
+        //!
+        //! @param duration the duration to wait for
+        //! @return the value or nullopt if the time elapsed or the queue was stopped
+        template<class Rep, class Period>
+        [[nodiscard]] std::optional<value_type> pop_wait_for(const std::chrono::duration<Rep, Period>& duration) noexcept
+        {
+            return pop_until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        }
+
+        //! Stop processing and wake any wating threads.
+        //!
+        //! Values still in the queue can be poped after stop.
+        void stop() noexcept
+        {
+            stopped.store(true);
+            not_empty.wake_all();
+            not_full.wake_all();
+        }
+
+    private:
+        struct cell
+        {
+            std::atomic<size_type> sequence;
+            alignas(value_type) std::byte storage[sizeof(value_type)];
+        };
+
+        alignas(cache_line_size) std::atomic<size_type> enqueue_pos = 0u;
+        alignas(cache_line_size) std::atomic<size_type> dequeue_pos = 0u;
+        alignas(cache_line_size) size_type              mask;
+        std::unique_ptr<cell[]>                         cells;
+
+        _parking                not_empty;
+        _parking                not_full;
+        std::atomic<bool>       stopped = false;
+
+        // claim a slot and construct the value in place, without waking anybody
+        template <typename... Args>
+        bool claim_push(Args&&... args) noexcept
+        {
+            auto pos  = enqueue_pos.load(std::memory_order_relaxed);
+            auto slot = static_cast<cell*>(nullptr);
+            while (true)
+            {
+                slot = &cells[pos & mask];
+                auto seq  = slot->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+                if (diff == 0)
+                {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            ::new (static_cast<void*>(slot->storage)) value_type(std::forward<Args>(args)...);
+            slot->sequence.store(pos + 1u, std::memory_order_release);
+            return true;
+        }
+
+        // claim a slot and move the value out, without waking anybody
+        std::optional<value_type> claim_pop() noexcept
+        {
+            auto pos  = dequeue_pos.load(std::memory_order_relaxed);
+            auto slot = static_cast<cell*>(nullptr);
+            while (true)
+            {
+                slot = &cells[pos & mask];
+                auto seq  = slot->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1u));
+                if (diff == 0)
+                {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return std::nullopt;
+                }
+                else
+                {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            auto ptr   = std::launder(reinterpret_cast<value_type*>(slot->storage));
+            auto value = std::optional<value_type>{std::move(*ptr)};
+            ptr->~value_type();
+            slot->sequence.store(pos + mask + 1u, std::memory_order_release);
+            return value;
+        }
+
+        std::optional<value_type> pop_until(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            auto value = std::optional<value_type>{};
+            if (not_empty.wait([&] () {
+                value = claim_pop();
+                return value.has_value();
+            }, stopped, deadline))
+            {
+                not_full.notify();
+            }
+            return value;
+        }
+
+        mpmc_queue(const mpmc_queue& other) = delete;
+        mpmc_queue& operator = (const mpmc_queue& other) = delete;
+    };
+}
+
+#endif
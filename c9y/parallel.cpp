@@ -29,7 +29,7 @@ namespace c9y
 {
     task_pool& _get_parallel_pool() noexcept
     {
-        static task_pool pool(std::thread::hardware_concurrency());
+        static task_pool pool(task_pool_options{.min_concurency = 0u});
         return pool;
     }
 }
@@ -30,9 +30,12 @@
 #include <numeric>
 #include <algorithm>
 #include <map>
+#include <atomic>
 
 #include "latch.h"
+#include "task.h"
 #include "task_pool.h"
+#include "executor.h"
 
 namespace c9y
 {
@@ -58,24 +61,81 @@ namespace c9y
         }
     }
 
+    //! Get the executor used by parallel algorithms without executor argument.
+    //!
+    //! This is the executor of the current scoped_executor or the
+    //! parallel pool.
+    [[nodiscard]] inline executor& _get_parallel_executor() noexcept
+    {
+        if (auto exec = get_current_executor())
+        {
+            return *exec;
+        }
+        return _get_parallel_pool();
+    }
+
+    //! Execute tasks in parallel and wait for them.
+    //!
+    //! All tasks are handed to the executor in one bulk enqueue. If called
+    //! from a task on the executor, the worker helps executing pending
+    //! tasks while it waits, so that nested parallel algorithms neither
+    //! block a worker nor deadlock the pool. The last task wakes it up.
+    inline void _parallel(executor& exec, std::vector<task>& tasks) noexcept
+    {
+        latch l(static_cast<std::ptrdiff_t>(tasks.size()));
+        auto remaining = std::atomic<size_t>{tasks.size()};
+
+        auto jobs = std::vector<task>{};
+        jobs.reserve(tasks.size());
+        for (auto& t : tasks)
+        {
+            jobs.emplace_back([&exec, &l, &remaining, &t] () {
+                t();
+                // the latch and counter may be gone after count_down
+                auto last = --remaining == 0u;
+                l.count_down();
+                if (last)
+                {
+                    exec.notify_run_until();
+                }
+            });
+        }
+
+        exec.enqueue_bulk(jobs);
+
+        if (exec.is_worker())
+        {
+            exec.run_until([&l] () {
+                return l.try_wait();
+            });
+        }
+        else
+        {
+            l.wait();
+        }
+    }
+
     //! Execute a tasks in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param begin the beginning of the sequence
     //! @param end the end of the sequence
     template <typename IteratorT>
-    void parallel(IteratorT begin, IteratorT end) noexcept
+    void parallel(executor& exec, IteratorT begin, IteratorT end) noexcept
     {
-        auto& pool = _get_parallel_pool();
-        latch l(std::distance(begin, end));
+        auto tasks = std::vector<task>{};
+        tasks.reserve(std::distance(begin, end));
         for (auto i = begin; i != end; ++i)
         {
-            auto task = *i;
-            pool.enqueue([&, task] () {
-                task();
-                l.count_down();
-            });
+            tasks.emplace_back(*i);
         }
-        l.wait();
+        _parallel(exec, tasks);
+    }
+
+    template <typename IteratorT>
+    void parallel(IteratorT begin, IteratorT end) noexcept
+    {
+        parallel(_get_parallel_executor(), begin, end);
     }
 
     //! Execute a tasks in parallel.
@@ -89,11 +149,22 @@ namespace c9y
         parallel(begin(tasks), end(tasks));
     }
 
+    template <typename Callable>
+    inline void parallel(executor& exec, const std::vector<Callable>& tasks) noexcept
+    {
+        parallel(exec, begin(tasks), end(tasks));
+    }
+
     inline void parallel(const std::vector<std::function<void ()>>& tasks) noexcept
     {
         parallel(begin(tasks), end(tasks));
     }
 
+    inline void parallel(executor& exec, const std::vector<std::function<void ()>>& tasks) noexcept
+    {
+        parallel(exec, begin(tasks), end(tasks));
+    }
+
     template <class Iterator>
     size_t safe_advance(Iterator& iter, const Iterator& end, size_t count)
     {
@@ -106,6 +177,7 @@ namespace c9y
     //!
     //! This function emulates std::all_of, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param predicate the function is called for each element
@@ -113,9 +185,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class UnaryOperation>
-    [[nodiscard]] bool parallel_all_of(InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
+    [[nodiscard]] bool parallel_all_of(executor& exec, InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<bool>(_get_results_size(std::distance(first, last), chunk_size), false);
 
         auto b  = first;
@@ -132,15 +204,22 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::all_of(begin(results), end(results), [] (const auto& v) {return v;});
     }
 
+    template <class InIterator, class UnaryOperation>
+    [[nodiscard]] bool parallel_all_of(InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
+    {
+        return parallel_all_of(_get_parallel_executor(), first, last, predicate, chunk_size);
+    }
+
     //! Checks if unary predicate returns true for at least one element in the range.
     //!
     //! This function emulates std::none_of, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param predicate the function is called for each element
@@ -148,9 +227,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class UnaryOperation>
-    [[nodiscard]] bool parallel_any_of(InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
+    [[nodiscard]] bool parallel_any_of(executor& exec, InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<bool>(_get_results_size(std::distance(first, last), chunk_size), false);
 
         auto b  = first;
@@ -167,15 +246,22 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::any_of(begin(results), end(results), [] (const auto& v) {return v;});
     }
 
+    template <class InIterator, class UnaryOperation>
+    [[nodiscard]] bool parallel_any_of(InIterator first, InIterator last, UnaryOperation predicate, size_t chunk_size = default_chunk_size)
+    {
+        return parallel_any_of(_get_parallel_executor(), first, last, predicate, chunk_size);
+    }
+
     //! Checks if unary predicate returns true for no elements in the range .
     //!
     //! This function emulates std::none_of, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param predicate the function is called for each element
@@ -183,9 +269,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class UnaryOperation>
-    [[nodiscard]] bool parallel_none_of(InIterator first, InIterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
+    [[nodiscard]] bool parallel_none_of(executor& exec, InIterator first, InIterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<bool>(_get_results_size(std::distance(first, last), chunk_size));
 
         auto b  = first;
@@ -202,17 +288,24 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         // Once we found the sequences that match none_of all of them must be true,
         // for all of them to be true.
         return std::all_of(begin(results), end(results), [] (const auto& v) {return v;});
     }
 
+    template <class InIterator, class UnaryOperation>
+    [[nodiscard]] bool parallel_none_of(InIterator first, InIterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
+    {
+        return parallel_none_of(_get_parallel_executor(), first, last, predicate, chunk_size);
+    }
+
     //! Counts the elements that are equal to value.
     //!
     //! This function emulates std::count, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param value the value to count
@@ -220,9 +313,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class Iterator, class Type>
-    [[nodiscard]] size_t parallel_count(Iterator first, Iterator last, Type value, unsigned int chunk_size = default_chunk_size)
+    [[nodiscard]] size_t parallel_count(executor& exec, Iterator first, Iterator last, Type value, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<size_t>(_get_results_size(std::distance(first, last), chunk_size), 0u);
 
         auto b  = first;
@@ -239,15 +332,22 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::accumulate(begin(results), end(results), size_t{0u});
     }
 
+    template <class Iterator, class Type>
+    [[nodiscard]] size_t parallel_count(Iterator first, Iterator last, Type value, unsigned int chunk_size = default_chunk_size)
+    {
+        return parallel_count(_get_parallel_executor(), first, last, value, chunk_size);
+    }
+
     //! counts elements for which predicate returns true.
     //!
     //! This function emulates std::count, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param predicate the function is called for each element
@@ -255,9 +355,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class Iterator, class UnaryOperation>
-    [[nodiscard]] size_t parallel_count_if(Iterator first, Iterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
+    [[nodiscard]] size_t parallel_count_if(executor& exec, Iterator first, Iterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<size_t>(_get_results_size(std::distance(first, last), chunk_size), 0u);
 
         auto b  = first;
@@ -274,15 +374,22 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::accumulate(begin(results), end(results), size_t{0u});
     }
 
+    template <class Iterator, class UnaryOperation>
+    [[nodiscard]] size_t parallel_count_if(Iterator first, Iterator last, UnaryOperation predicate, unsigned int chunk_size = default_chunk_size)
+    {
+        return parallel_count_if(_get_parallel_executor(), first, last, predicate, chunk_size);
+    }
+
     //! Reduces the range, possibly permuted and aggregated in unspecified manner.
     //!
     //! This function emulates std::count, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param first beginning of the sequence
     //! @param last the end of the sequence
     //! @param init the initial value
@@ -292,9 +399,9 @@ namespace c9y
     //! @see parallel
     //! @{
     template <class Iterator, class Type>
-    [[nodiscard]] Type parallel_reduce(Iterator first, Iterator last, Type init, unsigned int chunk_size = default_chunk_size)
+    [[nodiscard]] Type parallel_reduce(executor& exec, Iterator first, Iterator last, Type init, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<Type>(_get_results_size(std::distance(first, last), chunk_size), init);
 
         auto b  = first;
@@ -311,15 +418,21 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::reduce(begin(results), end(results), init);
     }
 
+    template <class Iterator, class Type>
+    [[nodiscard]] Type parallel_reduce(Iterator first, Iterator last, Type init, unsigned int chunk_size = default_chunk_size)
+    {
+        return parallel_reduce(_get_parallel_executor(), first, last, init, chunk_size);
+    }
+
     template <class Iterator, class Type, class BinaryOperator>
-    [[nodiscard]] Type parallel_reduce(Iterator first, Iterator last, Type init, BinaryOperator binary_op, unsigned int chunk_size = default_chunk_size)
+    [[nodiscard]] Type parallel_reduce(executor& exec, Iterator first, Iterator last, Type init, BinaryOperator binary_op, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks   = std::vector<std::function<void ()>>{};
+        auto tasks   = std::vector<task>{};
         auto results = std::vector<Type>(_get_results_size(std::distance(first, last), chunk_size), init);
 
         auto b  = first;
@@ -336,16 +449,23 @@ namespace c9y
             ri++;
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
 
         return std::reduce(begin(results), end(results), init, binary_op);
     }
+
+    template <class Iterator, class Type, class BinaryOperator>
+    [[nodiscard]] Type parallel_reduce(Iterator first, Iterator last, Type init, BinaryOperator binary_op, unsigned int chunk_size = default_chunk_size)
+    {
+        return parallel_reduce(_get_parallel_executor(), first, last, init, binary_op, chunk_size);
+    }
     //! @}
 
     //! Generate a number of values.
     //!
     //! This function emulates std::generate, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param start beginning of the sequence
     //! @param end the end of the sequence
     //! @param generator the function to generate values
@@ -353,9 +473,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class Iterator, class Generator>
-    void parallel_generate(Iterator start, Iterator end, Generator generator, unsigned int chunk_size = default_chunk_size)
+    void parallel_generate(executor& exec, Iterator start, Iterator end, Generator generator, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks = std::vector<std::function<void ()>>{};
+        auto tasks = std::vector<task>{};
 
         auto b = start;
         auto e = b;
@@ -369,13 +489,20 @@ namespace c9y
             safe_advance(e, end, chunk_size);
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
+    }
+
+    template <class Iterator, class Generator>
+    void parallel_generate(Iterator start, Iterator end, Generator generator, unsigned int chunk_size = default_chunk_size)
+    {
+        parallel_generate(_get_parallel_executor(), start, end, generator, chunk_size);
     }
 
     //! Transform one sequance to an other.
     //!
     //! This function emulates std::transform, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param istart beginning of the input sequence
     //! @param iend the end of the input sequence
     //! @param ostart beginning of the output sequence
@@ -384,9 +511,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class OutIterator, class UnaryOperation>
-    void parallel_transform(InIterator istart, InIterator iend, OutIterator ostart, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
+    void parallel_transform(executor& exec, InIterator istart, InIterator iend, OutIterator ostart, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks = std::vector<std::function<void ()>>{};
+        auto tasks = std::vector<task>{};
 
         auto ib = istart;
         auto ie = ib;
@@ -397,18 +524,25 @@ namespace c9y
             tasks.push_back([ib, ie, ob, &operation] () {
                 std::transform(ib, ie, ob, operation);
             });
+            std::advance(ob, std::distance(ib, ie));
             ib = ie;
-            auto n = safe_advance(ie, iend, chunk_size);
-            std::advance(ob, n);
+            safe_advance(ie, iend, chunk_size);
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
+    }
+
+    template <class InIterator, class OutIterator, class UnaryOperation>
+    void parallel_transform(InIterator istart, InIterator iend, OutIterator ostart, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
+    {
+        parallel_transform(_get_parallel_executor(), istart, iend, ostart, operation, chunk_size);
     }
 
     //! Execture a function for each element in a sequence.
     //!
     //! This function emulates std::for_rach, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param start beginning of the sequence
     //! @param end the end of the sequence
     //! @param operation the function is called for each element
@@ -416,9 +550,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class UnaryOperation>
-    void parallel_for_each(InIterator start, InIterator end, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
+    void parallel_for_each(executor& exec, InIterator start, InIterator end, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks = std::vector<std::function<void ()>>{};
+        auto tasks = std::vector<task>{};
 
         auto b = start;
         auto e = b;
@@ -432,13 +566,20 @@ namespace c9y
             auto n = safe_advance(e, end, chunk_size);
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
+    }
+
+    template <class InIterator, class UnaryOperation>
+    void parallel_for_each(InIterator start, InIterator end, UnaryOperation operation, unsigned int chunk_size = default_chunk_size)
+    {
+        parallel_for_each(_get_parallel_executor(), start, end, operation, chunk_size);
     }
 
     //! Copy one sequance to an other.
     //!
     //! This function emulates std::copy, but runs in parallel.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param istart beginning of the input sequence
     //! @param iend the end of the input sequence
     //! @param ostart beginning of the output sequence
@@ -447,9 +588,9 @@ namespace c9y
     //!
     //! @see parallel
     template <class InIterator, class OutIterator>
-    void parallel_copy(InIterator istart, InIterator iend, OutIterator ostart, unsigned int chunk_size = default_chunk_size)
+    void parallel_copy(executor& exec, InIterator istart, InIterator iend, OutIterator ostart, unsigned int chunk_size = default_chunk_size)
     {
-        auto tasks = std::vector<std::function<void ()>>{};
+        auto tasks = std::vector<task>{};
 
         auto ib = istart;
         auto ie = ib;
@@ -460,12 +601,18 @@ namespace c9y
             tasks.push_back([ib, ie, ob] () {
                 std::copy(ib, ie, ob);
             });
+            std::advance(ob, std::distance(ib, ie));
             ib = ie;
-            auto n = safe_advance(ie, iend, chunk_size);
-            std::advance(ob, n);
+            safe_advance(ie, iend, chunk_size);
         }
 
-        parallel(tasks);
+        _parallel(exec, tasks);
+    }
+
+    template <class InIterator, class OutIterator>
+    void parallel_copy(InIterator istart, InIterator iend, OutIterator ostart, unsigned int chunk_size = default_chunk_size)
+    {
+        parallel_copy(_get_parallel_executor(), istart, iend, ostart, chunk_size);
     }
 
     template <class Key, class OutValue>
@@ -481,13 +628,14 @@ namespace c9y
     //! This function will map and reduce input using the map / deuce algorithm using as many threads
     //! as sensibly usefull.
     //!
+    //! @param exec the executor that runs the tasks
     //! @param input input collection
     //! @param output output collection
     //! @param map the function to map from value to key
     //! @param reduce the function to reduce from key to result
     //! @param chunk_size the size of the batches used to form tasks
     template <class InCollection, class OutCollection>
-    void parallel_map_reduce(const InCollection& input, OutCollection& output,
+    void parallel_map_reduce(executor& exec, const InCollection& input, OutCollection& output,
                              std::function<typename OutCollection::value_type(const typename InCollection::value_type)> map,
                              std::function<typename OutCollection::value_type(std::pair<const typename OutCollection::key_type, std::list<typename OutCollection::mapped_type>>)> reduce,
                              unsigned int chunk_size = default_chunk_size)
@@ -496,7 +644,7 @@ namespace c9y
 
         // map
         state->mapped.resize(size(input));
-        parallel_transform(begin(input), end(input), begin(state->mapped), map, chunk_size);
+        parallel_transform(exec, begin(input), end(input), begin(state->mapped), map, chunk_size);
 
         // shuffle
         for (const auto& [key, value] : state->mapped)
@@ -506,11 +654,20 @@ namespace c9y
 
         // reduce
         state->reduced.resize(state->shuffled.size());
-        parallel_transform(begin(state->shuffled), end(state->shuffled), begin(state->reduced), reduce, chunk_size);
+        parallel_transform(exec, begin(state->shuffled), end(state->shuffled), begin(state->reduced), reduce, chunk_size);
 
         // remap
         output = OutCollection(begin(state->reduced), end(state->reduced));
     }
+
+    template <class InCollection, class OutCollection>
+    void parallel_map_reduce(const InCollection& input, OutCollection& output,
+                             std::function<typename OutCollection::value_type(const typename InCollection::value_type)> map,
+                             std::function<typename OutCollection::value_type(std::pair<const typename OutCollection::key_type, std::list<typename OutCollection::mapped_type>>)> reduce,
+                             unsigned int chunk_size = default_chunk_size)
+    {
+        parallel_map_reduce(_get_parallel_executor(), input, output, map, reduce, chunk_size);
+    }
 }
 
 #endif
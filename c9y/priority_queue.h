@@ -0,0 +1,318 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_PRIORITY_QUEUE_H_
+#define _C9Y_PRIORITY_QUEUE_H_
+
+#include "defines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Ordering guarantee of a priority_queue.
+    enum class priority_order
+    {
+        //! pop returns one of the highest values, scales with many threads
+        relaxed,
+        //! pop always returns the highest value, all threads share one lock
+        strict
+    };
+
+    //! Thread Safe Priority Queue
+    //!
+    //! The priority_queue is a MultiQueue: the values are spread over a number
+    //! of heaps, each with its own lock. push adds to a random heap that is
+    //! not locked and pop takes the better of the tops of two random heaps.
+    //! Threads rarely contend and the values come out close to priority order.
+    //! Each heap publishes it's size as a hint, so that pop skips empty heaps
+    //! without a shared counter.
+    //!
+    //! With priority_order::strict a single heap is used and pop always
+    //! returns the highest value.
+    //!
+    //! As with std::priority_queue, the highest value according to compare
+    //! comes first; use std::greater to pop the lowest first.
+    template <typename T, class Compare = std::less<T>>
+    class priority_queue
+    {
+    public:
+        using value_type    = T;
+        using size_type     = size_t;
+        using value_compare = Compare;
+
+        //! Create an empty priority queue.
+        //!
+        //! @param order the ordering guarantee
+        //! @param compare the compare function
+        explicit priority_queue(priority_order order = priority_order::relaxed, const Compare& compare = Compare{})
+        : lane_count(order == priority_order::strict ? 1u : std::max(2u * std::thread::hardware_concurrency(), 2u)),
+          lanes(std::make_unique<lane[]>(lane_count)),
+          compare(compare) {}
+
+        //! Destructor
+        ~priority_queue() = default;
+
+        //! Push a value onto the queue.
+        //!
+        //! This method will push the value onto the queue and wake up a thread
+        //! that is wating in pop_wait.
+        //!
+        //! @param value the value to push onto the queue
+        //!
+        //! @{
+        void push(const value_type& value) noexcept(std::is_nothrow_copy_constructible_v<value_type>)
+        {
+            emplace(value);
+        }
+
+        void push(value_type&& value) noexcept
+        {
+            emplace(std::move(value));
+        }
+
+        template<typename... Args>
+        void emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<value_type, Args...>)
+        {
+            auto& l   = lock_any_lane();
+            auto lock = std::unique_lock<std::mutex>{l.mutex, std::adopt_lock};
+            l.heap.emplace_back(std::forward<Args>(args)...);
+            std::push_heap(l.heap.begin(), l.heap.end(), compare);
+            l.size.store(l.heap.size(), std::memory_order_relaxed);
+            // A parked consumer locks every lane before it sleeps, so
+            // checking under the lane's lock needs no fence.
+            auto wake = not_empty.has_waiters();
+            lock.unlock();
+
+            if (wake)
+            {
+                not_empty.wake_one();
+            }
+        }
+        //! @}
+
+        //! Pop a value of the queue.
+        //!
+        //! @return the value or nullopt if the queue is empty
+        [[nodiscard]] std::optional<value_type> pop() noexcept
+        {
+            for (auto attempt = size_type{0u}; attempt < lane_count; attempt++)
+            {
+                // two random choices, skip empty and locked lanes
+                auto& a = lanes[random() % lane_count];
+                auto& b = lanes[random() % lane_count];
+                auto a_empty = a.size.load(std::memory_order_relaxed) == 0u;
+                auto b_empty = b.size.load(std::memory_order_relaxed) == 0u;
+                if (a_empty && b_empty)
+                {
+                    // the values are sparse, sweep
+                    break;
+                }
+
+                if (&a == &b || a_empty || b_empty)
+                {
+                    auto& l = a_empty ? b : a;
+                    if (l.mutex.try_lock())
+                    {
+                        auto lock = std::unique_lock<std::mutex>{l.mutex, std::adopt_lock};
+                        if (auto value = take(l))
+                        {
+                            return value;
+                        }
+                    }
+                }
+                else if (std::try_lock(a.mutex, b.mutex) == -1)
+                {
+                    auto lock_a = std::unique_lock<std::mutex>{a.mutex, std::adopt_lock};
+                    auto lock_b = std::unique_lock<std::mutex>{b.mutex, std::adopt_lock};
+                    if (auto value = take(better(a, b)))
+                    {
+                        return value;
+                    }
+                }
+            }
+            return sweep(false);
+        }
+
+        //! Pop a value of the queue, wait if nessesary.
+        //!
+        //! This method will try to pop a value off the queue. If no value is
+        //! in the queue, it will wait until either a value is pushed onto the
+        //! queue or stop is called.
+        //!
+        //! @return the value or nullopt if the queue was stopped
+        [[nodiscard]] std::optional<value_type> pop_wait() noexcept
+        {
+            return block(std::nullopt);
+        }
+
+        //! Pop a value of the queue, wait for a defined duration if nessesary.
+        //!
+        //! @param duration the duration to wait for
+        //! @return the value or nullopt if the time elapsed or the queue was stopped
+        template<class Rep, class Period>
+        [[nodiscard]] std::optional<value_type> pop_wait_for(const std::chrono::duration<Rep, Period>& duration) noexcept
+        {
+            return block(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        }
+
+        //! Stop processing and wake any wating threads.
+        //!
+        //! Values still in the queue can be poped after stop.
+        void stop() noexcept
+        {
+            stopped.store(true);
+            not_empty.wake_all();
+        }
+
+    private:
+        struct alignas(cache_line_size) lane
+        {
+            std::mutex              mutex;
+            std::vector<value_type> heap;
+            //! The size of heap, written under mutex and read without.
+            std::atomic<size_type>  size = 0u;
+        };
+
+        size_type               lane_count;
+        std::unique_ptr<lane[]> lanes;
+        Compare                 compare;
+
+        alignas(cache_line_size) _parking not_empty;
+        std::atomic<bool>                 stopped = false;
+
+        static uint32_t random() noexcept
+        {
+            // xorshift, good enough to pick lanes
+            thread_local auto state = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+            state ^= state << 13u;
+            state ^= state >> 17u;
+            state ^= state << 5u;
+            return state;
+        }
+
+        // lock a lane, preferring one that is not locked
+        lane& lock_any_lane() noexcept
+        {
+            for (auto attempt = size_type{0u}; attempt < lane_count; attempt++)
+            {
+                auto& l = lanes[random() % lane_count];
+                if (l.mutex.try_lock())
+                {
+                    return l;
+                }
+            }
+            auto& l = lanes[random() % lane_count];
+            l.mutex.lock();
+            return l;
+        }
+
+        // both lanes must be locked
+        lane& better(lane& a, lane& b) noexcept
+        {
+            if (a.heap.empty())
+            {
+                return b;
+            }
+            if (b.heap.empty())
+            {
+                return a;
+            }
+            return compare(a.heap.front(), b.heap.front()) ? b : a;
+        }
+
+        // the lane must be locked
+        std::optional<value_type> take(lane& l) noexcept
+        {
+            if (l.heap.empty())
+            {
+                return std::nullopt;
+            }
+            std::pop_heap(l.heap.begin(), l.heap.end(), compare);
+            auto value = std::optional<value_type>{std::move(l.heap.back())};
+            l.heap.pop_back();
+            l.size.store(l.heap.size(), std::memory_order_relaxed);
+            return value;
+        }
+
+        // take from the first lane that has a value, starting at a random
+        // lane; all lanes are locked if every is true, otherwise the empty
+        // ones are skipped by their hint
+        std::optional<value_type> sweep(bool every) noexcept
+        {
+            auto start = random();
+            for (auto i = size_type{0u}; i < lane_count; i++)
+            {
+                auto& l = lanes[(start + i) % lane_count];
+                if (!every && l.size.load(std::memory_order_relaxed) == 0u)
+                {
+                    continue;
+                }
+
+                auto lock = std::unique_lock<std::mutex>{l.mutex};
+                if (auto value = take(l))
+                {
+                    return value;
+                }
+            }
+            return std::nullopt;
+        }
+
+        // spin on pop and then park until a value is pushed or the queue
+        // is stopped; the last check before parking locks every lane, so
+        // that push sees the parked consumer under the lane's lock
+        std::optional<value_type> block(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            auto value = std::optional<value_type>{};
+            if (not_empty.spin([&] () {
+                value = pop();
+                return value.has_value();
+            }, stopped))
+            {
+                return value;
+            }
+
+            not_empty.park([&] () {
+                value = sweep(true);
+                return value.has_value();
+            }, stopped, deadline);
+            return value;
+        }
+
+        priority_queue(const priority_queue& other) = delete;
+        priority_queue& operator = (const priority_queue& other) = delete;
+    };
+}
+
+#endif
@@ -22,11 +22,19 @@
 #ifndef _C9Y_QUEUE_H_
 #define _C9Y_QUEUE_H_
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <iterator>
+#include <algorithm>
 #include <chrono>
 #include <optional>
+#include <vector>
+
+#include "fiber.h"
+#include "select.h"
+#include "waiter.h"
 
 namespace c9y
 {
@@ -62,42 +70,159 @@ namespace c9y
         //! Destructor
         ~queue() = default;
 
+        //! Limit the number of values in the queue.
+        //!
+        //! When the queue holds capacity values, push and emplace wait until a
+        //! value is poped. After stop is called, push no longer waits.
+        //!
+        //! @param value the maximum number of values, 0 for no limit
+        void set_capacity(size_type value) noexcept
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            capacity = value;
+            not_full.notify_all();
+            fiber_producers.notify_all();
+        }
+
+        //! Get the maximum number of values, 0 for no limit.
+        [[nodiscard]] size_type get_capacity() const noexcept
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            return capacity;
+        }
+
         //! Push a value onto the queue.
         //!
         //! This method will push the value onto the queue and
-        //! wake up a thread that is wating in pop_wait.
+        //! wake up a thread that is wating in pop_wait. If the queue is
+        //! full, it will wait until a value is poped.
         //!
         //! @param value the value to push onto the queue
         //!
         //! @{
         void push(const value_type& value) noexcept(std::is_nothrow_copy_constructible_v<value_type>)
         {
-            {
-                auto lock = std::unique_lock<std::mutex>{mutex};
-                container.push_back(value);
-            }
-            cond.notify_one();
+            insert(std::nullopt, value);
         }
 
         void push(value_type&& value) noexcept
         {
-            {
-                auto lock = std::unique_lock<std::mutex>{mutex};
-                container.push_back(std::forward<value_type>(value));
-            }
-            cond.notify_one();
+            insert(std::nullopt, std::forward<value_type>(value));
         }
 
         template<typename... Args>
         void emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<value_type, Args...>)
         {
+            insert(std::nullopt, std::forward<Args>(args)...);
+        }
+        //! @}
+
+        //! Push a value onto the queue, wait for a defined duration if nessesary.
+        //!
+        //! @param value the value to push onto the queue
+        //! @param duration the duration to wait for
+        //! @return true if the value was pushed, false if the queue stayed full
+        //!
+        //! @{
+        template<class Rep, class Period>
+        [[nodiscard]] bool push_wait_for(const value_type& value, const std::chrono::duration<Rep, Period>& duration) noexcept(std::is_nothrow_copy_constructible_v<value_type>)
+        {
+            return insert(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration), value);
+        }
+
+        template<class Rep, class Period>
+        [[nodiscard]] bool push_wait_for(value_type&& value, const std::chrono::duration<Rep, Period>& duration) noexcept
+        {
+            return insert(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration), std::forward<value_type>(value));
+        }
+        //! @}
+
+        //! Try to push a value onto the queue.
+        //!
+        //! @param value the value to push onto the queue
+        //! @return true if the value was pushed, false if the queue is full
+        //!
+        //! @{
+        [[nodiscard]] bool try_push(const value_type& value) noexcept(std::is_nothrow_copy_constructible_v<value_type>)
+        {
+            return insert(std::chrono::steady_clock::time_point::min(), value);
+        }
+
+        [[nodiscard]] bool try_push(value_type&& value) noexcept
+        {
+            return insert(std::chrono::steady_clock::time_point::min(), std::forward<value_type>(value));
+        }
+        //! @}
+
+        //! Push a range of values onto the queue.
+        //!
+        //! The values are pushed under one lock and the waiting threads are
+        //! woken once. If the queue has a capacity, it waits for room as
+        //! needed.
+        //!
+        //! @param first an iterator to the beginning of the range
+        //! @param last an iterator to the one beond the end of the range
+        template <typename InputIt>
+        void push_range(InputIt first, InputIt last)
+        {
+            auto count = size_type{0u};
+            auto wake  = false;
             {
                 auto lock = std::unique_lock<std::mutex>{mutex};
-                container.emplace_back(std::forward<Args>(args)...);
+                if (capacity == 0u)
+                {
+                    auto before = container.size();
+                    container.insert(container.end(), first, last);
+                    count = container.size() - before;
+                }
+                else
+                {
+                    for (; first != last; ++first)
+                    {
+                        if (!has_room())
+                        {
+                            // let the consumers drain what we have so far
+                            size.store(container.size(), std::memory_order_relaxed);
+                            if (consumers_waiting != 0u)
+                            {
+                                cond.notify_all();
+                            }
+                            fiber_consumers.notify_all();
+                            signal_selectors();
+                            wait_not_full(lock, std::nullopt);
+                        }
+                        container.push_back(*first);
+                        count++;
+                    }
+                }
+                size.store(container.size(), std::memory_order_relaxed);
+                wake = consumers_waiting != 0u;
+                if (count > 1u)
+                {
+                    fiber_consumers.notify_all();
+                }
+                else if (count == 1u)
+                {
+                    fiber_consumers.notify_one();
+                }
+                if (count != 0u)
+                {
+                    signal_selectors();
+                }
+            }
+            if (!wake)
+            {
+                return;
+            }
+            if (count > 1u)
+            {
+                cond.notify_all();
+            }
+            else if (count == 1u)
+            {
+                cond.notify_one();
             }
-            cond.notify_one();
         }
-        //! @}
 
         //! Pop a value of the queue.
         //!
@@ -108,17 +233,13 @@ namespace c9y
         //! @return true if a value was poped of the queue
         [[nodiscard]] std::optional<value_type> pop() noexcept
         {
-            auto lock = std::unique_lock<std::mutex>{mutex};
-            if (!container.empty())
-            {
-                auto value = std::move(container.front());
-                container.pop_front();
-                return value;
-            }
-            else
+            if (size.load(std::memory_order_relaxed) == 0u)
             {
                 return std::nullopt;
             }
+
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            return take_front();
         }
 
         //! Pop a value of the queue, wait if nessesary.
@@ -135,17 +256,19 @@ namespace c9y
         //! pop_wait_for with a reasonable timeout.
         [[nodiscard]] std::optional<value_type> pop_wait() noexcept
         {
-            auto lock = std::unique_lock<std::mutex>{mutex};
-            cond.wait(lock, [&]{return !container.empty() || stopped;});
-
-            if (container.empty())
+            if (fiber::current())
             {
-                return std::nullopt;
+                return fiber_pop_wait(std::nullopt);
             }
 
-            auto value = std::move(container.front());;
-            container.pop_front();
-            return value;
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            if (container.empty() && !stopped)
+            {
+                consumers_waiting++;
+                cond.wait(lock, [&]{return !container.empty() || stopped;});
+                consumers_waiting--;
+            }
+            return take_front();
         }
 
         //! Pop a value of the queue, wait for a defined duration if nessesary.
@@ -160,17 +283,91 @@ namespace c9y
         template<class Rep, class Period>
         [[nodiscard]] std::optional<value_type> pop_wait_for(const std::chrono::duration<Rep, Period>& duration) noexcept
         {
+            if (fiber::current())
+            {
+                return fiber_pop_wait(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+            }
+
             auto lock = std::unique_lock<std::mutex>{mutex};
-            cond.wait_for(lock, duration, [&]{return !container.empty() || stopped;});
+            if (container.empty() && !stopped)
+            {
+                consumers_waiting++;
+                cond.wait_for(lock, duration, [&]{return !container.empty() || stopped;});
+                consumers_waiting--;
+            }
+            return take_front();
+        }
 
-            if (container.empty())
+        //! Pop up to max values of the queue.
+        //!
+        //! This method will pop the values under one lock and does not wait.
+        //!
+        //! @param out the output iterator to move the values to
+        //! @param max the maximum number of values to pop
+        //! @return the number of values poped
+        template <typename OutputIt>
+        size_type pop_n(OutputIt out, size_type max)
+        {
+            auto values = Container{};
             {
-                return std::nullopt;
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                if (max >= container.size())
+                {
+                    std::swap(values, container);
+                }
+                else
+                {
+                    auto end = std::next(container.begin(), max);
+                    values.insert(values.end(), std::make_move_iterator(container.begin()), std::make_move_iterator(end));
+                    container.erase(container.begin(), end);
+                }
+                size.store(container.size(), std::memory_order_relaxed);
+                wake_producers(values.size());
             }
+            std::move(values.begin(), values.end(), out);
+            return values.size();
+        }
 
-            auto value = std::move(container.front());
-            container.pop_front();
-            return value;
+        //! Pop all values of the queue, wait if nessesary.
+        //!
+        //! This method will wait until values are in the queue or stop is
+        //! called and then swap out the entire container under one lock.
+        //!
+        //! @param out the output iterator to move the values to
+        //! @return the number of values poped, 0 if the queue was stopped
+        template <typename OutputIt>
+        size_type pop_all_wait(OutputIt out)
+        {
+            auto values = Container{};
+            auto take   = [&] () {
+                if (!container.empty())
+                {
+                    std::swap(values, container);
+                    size.store(0u, std::memory_order_relaxed);
+                    wake_producers(values.size());
+                    return true;
+                }
+                return stopped;
+            };
+
+            if (fiber::current())
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                fiber_consumers.wait(lock, take);
+            }
+            else
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                if (!take())
+                {
+                    consumers_waiting++;
+                    cond.wait(lock, take);
+                    consumers_waiting--;
+                }
+            }
+
+            std::move(values.begin(), values.end(), out);
+            return values.size();
         }
 
         //! Stop processing and wake any wating threads.
@@ -182,15 +379,147 @@ namespace c9y
             {
                 auto lock = std::unique_lock<std::mutex>{mutex};
                 stopped = true;
+                fiber_consumers.notify_all();
+                fiber_producers.notify_all();
+                signal_selectors();
             }
             cond.notify_all();
+            not_full.notify_all();
         }
 
     private:
-        std::mutex              mutex;
-        std::condition_variable cond;
-        Container               container;
-        bool                    stopped = false;
+        mutable std::mutex           mutex;
+        std::condition_variable      cond;
+        std::condition_variable      not_full;
+        Container                    container;
+        std::vector<_waiter*>        selectors;
+        _wait_list                   fiber_consumers;
+        _wait_list                   fiber_producers;
+        std::atomic<size_type>       size              = 0u;
+        size_type                    capacity          = 0u;
+        size_type                    consumers_waiting = 0u;
+        size_type                    producers_waiting = 0u;
+        bool                         stopped           = false;
+
+        // push a value, deadline nullopt waits for room as long as needed
+        template <typename... Args>
+        bool insert(std::optional<std::chrono::steady_clock::time_point> deadline, Args&&... args)
+        {
+            auto wake = false;
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                if (!wait_not_full(lock, deadline))
+                {
+                    return false;
+                }
+                container.emplace_back(std::forward<Args>(args)...);
+                size.store(container.size(), std::memory_order_relaxed);
+                // only pay for the notify when a consumer is parked
+                wake = consumers_waiting != 0u;
+                fiber_consumers.notify_one();
+                signal_selectors();
+            }
+            if (wake)
+            {
+                cond.notify_one();
+            }
+            return true;
+        }
+
+        // wake the selects waiting on this queue, lock must be held
+        void signal_selectors() noexcept
+        {
+            for (auto waiter : selectors)
+            {
+                waiter->signal();
+            }
+        }
+
+        // lock must be held
+        bool has_room() const noexcept
+        {
+            return capacity == 0u || container.size() < capacity || stopped;
+        }
+
+        // wait until a value fits, lock must be held; not_full is only
+        // signaled while producers_waiting is not zero
+        bool wait_not_full(std::unique_lock<std::mutex>& lock, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            while (!has_room())
+            {
+                if (deadline && std::chrono::steady_clock::now() >= *deadline)
+                {
+                    return false;
+                }
+
+                if (fiber::current())
+                {
+                    fiber_producers.wait(lock, [&]{return has_room();}, deadline);
+                    continue;
+                }
+
+                producers_waiting++;
+                if (deadline)
+                {
+                    not_full.wait_until(lock, *deadline, [&]{return has_room();});
+                }
+                else
+                {
+                    not_full.wait(lock, [&]{return has_room();});
+                }
+                producers_waiting--;
+            }
+            return true;
+        }
+
+        // lock must be held
+        void wake_producers(size_type count) noexcept
+        {
+            if (producers_waiting != 0u && count != 0u)
+            {
+                if (count == 1u)
+                {
+                    not_full.notify_one();
+                }
+                else
+                {
+                    not_full.notify_all();
+                }
+            }
+            if (count == 1u)
+            {
+                fiber_producers.notify_one();
+            }
+            else if (count > 1u)
+            {
+                fiber_producers.notify_all();
+            }
+        }
+
+        // take the front value, lock must be held
+        std::optional<value_type> take_front() noexcept
+        {
+            if (container.empty())
+            {
+                return std::nullopt;
+            }
+
+            auto value = std::optional<value_type>{std::move(container.front())};
+            container.pop_front();
+            size.store(container.size(), std::memory_order_relaxed);
+            wake_producers(1u);
+            return value;
+        }
+
+        // park the fiber without blocking the worker
+        std::optional<value_type> fiber_pop_wait(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            fiber_consumers.wait(lock, [&]{return !container.empty() || stopped;}, deadline);
+            return take_front();
+        }
+
+        friend class _select;
 
         queue(const queue& other) = delete;
         queue& operator = (const queue& other) = delete;
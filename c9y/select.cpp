@@ -0,0 +1,95 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "select.h"
+
+namespace c9y
+{
+    namespace
+    {
+        std::optional<size_t> find_ready(std::span<_select_entry> entries, size_t start) noexcept
+        {
+            for (auto i = 0u; i < entries.size(); i++)
+            {
+                auto index = (start + i) % entries.size();
+                if (entries[index].ready(entries[index].queue))
+                {
+                    return index;
+                }
+            }
+            return std::nullopt;
+        }
+
+        size_t random_start(size_t count) noexcept
+        {
+            // cheap and without state shared between selects
+            return static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count()) % count;
+        }
+    }
+
+    std::optional<size_t> _select_wait(select_policy policy, size_t* turn, std::optional<std::chrono::steady_clock::time_point> deadline, std::span<_select_entry> entries) noexcept
+    {
+        if (entries.empty())
+        {
+            return std::nullopt;
+        }
+
+        // fair starts looking after the queue reported last time
+        auto start = size_t{0u};
+        if (policy == select_policy::fair)
+        {
+            start = turn ? *turn % entries.size() : random_start(entries.size());
+        }
+        auto result = find_ready(entries, start);
+
+        if (!result)
+        {
+            // attach before checking again, so no push goes unnoticed; in
+            // a fiber the waiter parks the fiber instead of the thread
+            auto waiter = _waiter{};
+            for (auto& entry : entries)
+            {
+                entry.attach(entry.queue, &waiter);
+            }
+
+            while (!(result = find_ready(entries, start)))
+            {
+                if (!waiter.wait(deadline))
+                {
+                    break;
+                }
+            }
+
+            for (auto& entry : entries)
+            {
+                entry.detach(entry.queue, &waiter);
+            }
+        }
+
+        if (result && turn)
+        {
+            *turn = *result + 1u;
+        }
+        return result;
+    }
+}
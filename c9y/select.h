@@ -0,0 +1,173 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_SELECT_H_
+#define _C9Y_SELECT_H_
+
+#include "defines.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <span>
+
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Which queue select reports when several are ready.
+    enum class select_policy
+    {
+        //! the first ready queue in argument order
+        prioritized,
+        //! the ready queues take turns, see selector
+        fair
+    };
+
+    //! Type erased queue for select.
+    struct _select_entry
+    {
+        void* queue;
+        bool (*ready)(void* queue) noexcept;
+        void (*attach)(void* queue, _waiter* waiter) noexcept;
+        void (*detach)(void* queue, _waiter* waiter) noexcept;
+    };
+
+    //! Wait for a ready entry; with the fair policy the search starts at
+    //! turn and turn moves past the result, without a turn at a random entry.
+    C9Y_EXPORT std::optional<size_t> _select_wait(select_policy policy, size_t* turn, std::optional<std::chrono::steady_clock::time_point> deadline, std::span<_select_entry> entries) noexcept;
+
+    //! Access to the queue internals, queues befriend this.
+    class _select
+    {
+    public:
+        template <typename Queue>
+        static _select_entry entry(Queue& queue) noexcept
+        {
+            return {
+                &queue,
+                [] (void* q) noexcept {
+                    auto& self = *static_cast<Queue*>(q);
+                    auto lock  = std::unique_lock<std::mutex>{self.mutex};
+                    return !self.container.empty() || self.stopped;
+                },
+                [] (void* q, _waiter* waiter) noexcept {
+                    auto& self = *static_cast<Queue*>(q);
+                    auto lock  = std::unique_lock<std::mutex>{self.mutex};
+                    self.selectors.push_back(waiter);
+                },
+                [] (void* q, _waiter* waiter) noexcept {
+                    auto& self = *static_cast<Queue*>(q);
+                    auto lock  = std::unique_lock<std::mutex>{self.mutex};
+                    self.selectors.erase(std::remove(self.selectors.begin(), self.selectors.end(), waiter), self.selectors.end());
+                }
+            };
+        }
+    };
+
+    //! Wait until one of several queues has a value or is stopped.
+    //!
+    //! The queues do not need to hold the same type. select does not pop
+    //! the value, call pop on the reported queue; if an other consumer was
+    //! faster or the queue was stopped, pop returns nullopt.
+    //!
+    //! Without state between the calls, the fair policy starts looking at a
+    //! random queue; use a selector for strict turns.
+    //!
+    //! @param policy which queue to report when several are ready
+    //! @param queues the queues to wait on
+    //! @return the index of the ready queue in the argument list
+    template <typename... Queues>
+    size_t select(select_policy policy, Queues&... queues) noexcept
+    {
+        static_assert(sizeof...(Queues) > 0u, "select needs at least one queue");
+        auto entries = std::array<_select_entry, sizeof...(Queues)>{_select::entry(queues)...};
+        return *_select_wait(policy, nullptr, std::nullopt, entries);
+    }
+
+    //! Wait for a defined duration until one of several queues has a value
+    //! or is stopped.
+    //!
+    //! @param policy which queue to report when several are ready
+    //! @param duration the duration to wait for
+    //! @param queues the queues to wait on
+    //! @return the index of the ready queue or nullopt if the time elapsed
+    template <class Rep, class Period, typename... Queues>
+    std::optional<size_t> select_for(select_policy policy, const std::chrono::duration<Rep, Period>& duration, Queues&... queues) noexcept
+    {
+        static_assert(sizeof...(Queues) > 0u, "select_for needs at least one queue");
+        auto entries  = std::array<_select_entry, sizeof...(Queues)>{_select::entry(queues)...};
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+        return _select_wait(policy, nullptr, deadline, entries);
+    }
+
+    //! Selector
+    //!
+    //! A selector waits on several queues like select and keeps the turn
+    //! of the fair policy, so that the ready queues are reported in strict
+    //! rotation. Each selector has it's own turn; a selector must not be
+    //! used by several threads at once.
+    class selector
+    {
+    public:
+        //! Create a selector.
+        //!
+        //! @param policy which queue to report when several are ready
+        explicit selector(select_policy policy = select_policy::fair) noexcept
+        : policy(policy) {}
+
+        //! Wait until one of several queues has a value or is stopped.
+        //!
+        //! @param queues the queues to wait on
+        //! @return the index of the ready queue in the argument list
+        template <typename... Queues>
+        size_t select(Queues&... queues) noexcept
+        {
+            static_assert(sizeof...(Queues) > 0u, "select needs at least one queue");
+            auto entries = std::array<_select_entry, sizeof...(Queues)>{_select::entry(queues)...};
+            return *_select_wait(policy, &turn, std::nullopt, entries);
+        }
+
+        //! Wait for a defined duration until one of several queues has a
+        //! value or is stopped.
+        //!
+        //! @param duration the duration to wait for
+        //! @param queues the queues to wait on
+        //! @return the index of the ready queue or nullopt if the time elapsed
+        template <class Rep, class Period, typename... Queues>
+        std::optional<size_t> select_for(const std::chrono::duration<Rep, Period>& duration, Queues&... queues) noexcept
+        {
+            static_assert(sizeof...(Queues) > 0u, "select_for needs at least one queue");
+            auto entries  = std::array<_select_entry, sizeof...(Queues)>{_select::entry(queues)...};
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+            return _select_wait(policy, &turn, deadline, entries);
+        }
+
+    private:
+        select_policy policy;
+        size_t        turn = 0u;
+    };
+}
+
+#endif
@@ -0,0 +1,306 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_SPSC_QUEUE_H_
+#define _C9Y_SPSC_QUEUE_H_
+
+#include "defines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "utils.h"
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Bounded Wait-Free Single Producer Single Consumer Queue
+    //!
+    //! The spsc_queue is a fixed capacity ring buffer for exactly one
+    //! producing and one consuming thread. Each side owns its index and keeps
+    //! a cached copy of the other side's index on its own cache line, so the
+    //! shared cache lines are only touched when the cached view runs out.
+    //!
+    //! Besides the queue interface, write_span / commit_write and
+    //! read_span / commit_read give direct access to the slots, so batches
+    //! can be filled and consumed in place.
+    //!
+    //! The slots hold constructed values, value_type must be default
+    //! constructible and move assignable.
+    //!
+    //! By default the queue never waits and a commit is a single release
+    //! store. With Blocking set, push, pop_wait and the wait functions
+    //! become available; every commit then pays for a full fence to check
+    //! if the other side is parked.
+    //!
+    //! @warning Calling the producer functions from more than one thread or
+    //! the consumer functions from more than one thread is undefined.
+    template <typename T, bool Blocking = false>
+    class spsc_queue
+    {
+    public:
+        using value_type = T;
+        using size_type  = size_t;
+
+        //! Create an empty queue.
+        //!
+        //! @param capacity the maximum number of values, rounded up to the
+        //! next power of two
+        explicit spsc_queue(size_type capacity)
+        : mask(std::bit_ceil(std::max<size_type>(capacity, 1u)) - 1u),
+          buffer(std::make_unique<value_type[]>(mask + 1u)) {}
+
+        //! Destructor
+        ~spsc_queue() = default;
+
+        //! The maximum number of values the queue can hold.
+        size_type capacity() const noexcept
+        {
+            return mask + 1u;
+        }
+
+        //! Push a value onto the queue.
+        //!
+        //! If the queue is full, it waits until a value is poped or the queue
+        //! is stopped.
+        //!
+        //! @param value the value to push onto the queue
+        //! @return false if the queue was stopped while full
+        //!
+        //! @{
+        bool push(const value_type& value) noexcept requires Blocking
+        {
+            return emplace(value);
+        }
+
+        bool push(value_type&& value) noexcept requires Blocking
+        {
+            return emplace(std::move(value));
+        }
+
+        template <typename... Args>
+        bool emplace(Args&&... args) noexcept requires Blocking
+        {
+            if (!wait_writable())
+            {
+                return false;
+            }
+            return try_emplace(std::forward<Args>(args)...);
+        }
+        //! @}
+
+        //! Try to push a value onto the queue.
+        //!
+        //! @param value the value to push onto the queue
+        //! @return false if the queue is full and the value was not pushed
+        //!
+        //! @{
+        [[nodiscard]] bool try_push(const value_type& value) noexcept
+        {
+            return try_emplace(value);
+        }
+
+        [[nodiscard]] bool try_push(value_type&& value) noexcept
+        {
+            return try_emplace(std::move(value));
+        }
+
+        template <typename... Args>
+        [[nodiscard]] bool try_emplace(Args&&... args) noexcept
+        {
+            auto span = write_span(1u);
+            if (span.empty())
+            {
+                return false;
+            }
+            span[0] = value_type(std::forward<Args>(args)...);
+            commit_write(1u);
+            return true;
+        }
+        //! @}
+
+        //! Pop a value of the queue.
+        //!
+        //! @return the value or nullopt if the queue is empty
+        [[nodiscard]] std::optional<value_type> pop() noexcept
+        {
+            auto span = read_span(1u);
+            if (span.empty())
+            {
+                return std::nullopt;
+            }
+            auto value = std::optional<value_type>{std::move(span[0])};
+            commit_read(1u);
+            return value;
+        }
+
+        //! Pop a value of the queue, wait if nessesary.
+        //!
+        //! @return the value or nullopt if the queue was stopped and is empty
+        [[nodiscard]] std::optional<value_type> pop_wait() noexcept requires Blocking
+        {
+            wait_readable(std::nullopt);
+            return pop();
+        }
+
+        //! Pop a value of the queue, wait for a defined duration if nessesary.
+        //!
+        //! @param duration the duration to wait for
+        //! @return the value or nullopt if the time elapsed or the queue was stopped
+        template<class Rep, class Period>
+        [[nodiscard]] std::optional<value_type> pop_wait_for(const std::chrono::duration<Rep, Period>& duration) noexcept requires Blocking
+        {
+            wait_readable(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+            return pop();
+        }
+
+        //! Get the free slots to write to.
+        //!
+        //! The span does not wrap around the end of the buffer, so it may be
+        //! shorter than the free space. The values become visible to the
+        //! consumer with commit_write.
+        //!
+        //! @param max the maximum number of slots
+        //! @return the writable slots, empty if the queue is full
+        [[nodiscard]] std::span<value_type> write_span(size_type max = SIZE_MAX) noexcept
+        {
+            auto t    = tail.load(std::memory_order_relaxed);
+            auto free = capacity() - (t - head_cache);
+            if (free < max)
+            {
+                head_cache = head.load(std::memory_order_acquire);
+                free       = capacity() - (t - head_cache);
+            }
+            auto index = t & mask;
+            auto count = std::min({max, free, capacity() - index});
+            return {buffer.get() + index, count};
+        }
+
+        //! Publish the first count slots of the last write_span.
+        void commit_write(size_type count) noexcept
+        {
+            tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+            if constexpr (Blocking)
+            {
+                not_empty.notify();
+            }
+        }
+
+        //! Get the values ready to read.
+        //!
+        //! The span does not wrap around the end of the buffer, so it may be
+        //! shorter than the number of values in the queue. The slots are
+        //! given back to the producer with commit_read.
+        //!
+        //! @param max the maximum number of values
+        //! @return the readable values, empty if the queue is empty
+        [[nodiscard]] std::span<value_type> read_span(size_type max = SIZE_MAX) noexcept
+        {
+            auto h     = head.load(std::memory_order_relaxed);
+            auto avail = tail_cache - h;
+            if (avail < max)
+            {
+                tail_cache = tail.load(std::memory_order_acquire);
+                avail      = tail_cache - h;
+            }
+            auto index = h & mask;
+            auto count = std::min({max, avail, capacity() - index});
+            return {buffer.get() + index, count};
+        }
+
+        //! Release the first count values of the last read_span.
+        void commit_read(size_type count) noexcept
+        {
+            head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+            if constexpr (Blocking)
+            {
+                not_full.notify();
+            }
+        }
+
+        //! Wait until there is at least one value to read.
+        //!
+        //! @return false if the queue was stopped and is empty
+        bool wait_readable() noexcept requires Blocking
+        {
+            return wait_readable(std::nullopt);
+        }
+
+        //! Wait until there is at least one free slot.
+        //!
+        //! @return false if the queue was stopped while full
+        bool wait_writable() noexcept requires Blocking
+        {
+            return not_full.wait([this] () {
+                return !write_span(1u).empty();
+            }, stopped, std::nullopt);
+        }
+
+        //! Stop processing and wake any wating threads.
+        //!
+        //! Values still in the queue can be poped after stop.
+        void stop() noexcept requires Blocking
+        {
+            stopped.store(true);
+            not_empty.wake_all();
+            not_full.wake_all();
+        }
+
+    private:
+        // the queue that never waits does not carry the parking state
+        struct no_parking {};
+        using parking = std::conditional_t<Blocking, _parking, no_parking>;
+
+        // consumer
+        alignas(cache_line_size) std::atomic<size_type> head = 0u;
+        size_type                                       tail_cache = 0u;
+        // producer
+        alignas(cache_line_size) std::atomic<size_type> tail = 0u;
+        size_type                                       head_cache = 0u;
+        // shared, read only
+        alignas(cache_line_size) size_type              mask;
+        std::unique_ptr<value_type[]>                   buffer;
+
+        parking                 not_empty;
+        parking                 not_full;
+        std::atomic<bool>       stopped = false;
+
+        bool wait_readable(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            return not_empty.wait([this] () {
+                return !read_span(1u).empty();
+            }, stopped, deadline);
+        }
+
+        spsc_queue(const spsc_queue& other) = delete;
+        spsc_queue& operator = (const spsc_queue& other) = delete;
+    };
+}
+
+#endif
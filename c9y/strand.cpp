@@ -0,0 +1,193 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "strand.h"
+
+#include <algorithm>
+
+#include "exceptions.h"
+
+namespace c9y
+{
+    thread_local const strand* this_strand = nullptr;
+
+    strand::strand(executor& e, size_t b) noexcept
+    : exec(e), batch_size(std::max<size_t>(b, 1u)) {}
+
+    strand::~strand()
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        cond.wait(lock, [this] {return !scheduled;});
+    }
+
+    void strand::enqueue(task func) noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        tasks.push_back(std::move(func));
+        if (!scheduled)
+        {
+            scheduled = true;
+            lock.unlock();
+            schedule();
+        }
+        else if (helping != 0)
+        {
+            // a task of the strand waits in run_until and executes the new task
+            lock.unlock();
+            exec.notify_run_until();
+        }
+    }
+
+    void strand::enqueue_bulk(std::vector<task>& bulk) noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        for (auto& func : bulk)
+        {
+            tasks.push_back(std::move(func));
+        }
+        if (!scheduled && !tasks.empty())
+        {
+            scheduled = true;
+            lock.unlock();
+            schedule();
+        }
+        else if (helping != 0)
+        {
+            lock.unlock();
+            exec.notify_run_until();
+        }
+    }
+
+    bool strand::is_worker() const noexcept
+    {
+        return this_strand == this;
+    }
+
+    void strand::run_until(const std::function<bool ()>& done) noexcept
+    {
+        if (!is_worker())
+        {
+            exec.run_until(done);
+            return;
+        }
+
+        while (!done())
+        {
+            if (auto func = pop())
+            {
+                try
+                {
+                    func();
+                }
+                catch (...)
+                {
+                    unhandled_exception();
+                }
+                continue;
+            }
+
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                helping++;
+            }
+            exec.run_until([&] () {
+                {
+                    auto lock = std::unique_lock<std::mutex>{mutex};
+                    if (!tasks.empty())
+                    {
+                        return true;
+                    }
+                }
+                return done();
+            });
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                helping--;
+            }
+        }
+    }
+
+    void strand::notify_run_until() noexcept
+    {
+        exec.notify_run_until();
+    }
+
+    void strand::schedule() noexcept
+    {
+        exec.enqueue([this] () {
+            drain();
+        });
+    }
+
+    task strand::pop() noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        if (tasks.empty())
+        {
+            return nullptr;
+        }
+
+        auto func = std::move(tasks.front());
+        tasks.pop_front();
+        return func;
+    }
+
+    void strand::drain() noexcept
+    {
+        auto previous = this_strand;
+        this_strand = this;
+
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            auto func = pop();
+            if (!func)
+            {
+                break;
+            }
+
+            try
+            {
+                func();
+            }
+            catch (...)
+            {
+                unhandled_exception();
+            }
+        }
+
+        this_strand = previous;
+
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        if (tasks.empty())
+        {
+            scheduled = false;
+            cond.notify_all();
+        }
+        else
+        {
+            // reschedule instead of looping, so that other work is not starved
+            lock.unlock();
+            schedule();
+        }
+    }
+}
@@ -0,0 +1,106 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_STRAND_H_
+#define _C9Y_STRAND_H_
+
+#include "defines.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "executor.h"
+#include "task.h"
+
+namespace c9y
+{
+    //! Strand
+    //!
+    //! A strand runs tasks one at a time in FIFO order on an other executor,
+    //! usually a task_pool. Different strands on the same executor run in
+    //! parallel. This gives per entity ordering without a thread per entity.
+    //!
+    //! The strand is scheduled on the executor as one task that drains up to
+    //! batch_size queued tasks, to amortise the handoff. If there are more,
+    //! the strand is rescheduled, so that other work is not starved.
+    class C9Y_EXPORT strand : public executor
+    {
+    public:
+        //! The default number of tasks executed per scheduling.
+        static constexpr size_t default_batch_size = 16u;
+
+        //! Create a strand on an executor.
+        //!
+        //! @param exec the executor that runs the tasks
+        //! @param batch_size the maximum number of tasks executed per scheduling
+        explicit strand(executor& exec, size_t batch_size = default_batch_size) noexcept;
+
+        //! Destructor
+        //!
+        //! The destructor waits until all queued tasks are executed. It may
+        //! not be called from a task of the strand.
+        ~strand();
+
+        //! Add a task to the strand.
+        //!
+        //! @param func the task to execute
+        void enqueue(task func) noexcept override;
+
+        //! Add a batch of tasks to the strand.
+        //!
+        //! @param tasks the tasks to execute
+        void enqueue_bulk(std::vector<task>& tasks) noexcept override;
+
+        //! Check if the calling thread executes a task of this strand.
+        [[nodiscard]] bool is_worker() const noexcept override;
+
+        //! Wait until a condition is met.
+        //!
+        //! When called from a task of the strand, the following tasks of the
+        //! strand are executed while waiting, in order.
+        //!
+        //! @param done the condition to wait for
+        void run_until(const std::function<bool ()>& done) noexcept override;
+
+        //! Wake the threads waiting in run_until.
+        void notify_run_until() noexcept override;
+
+    private:
+        executor&               exec;
+        size_t                  batch_size;
+        std::mutex              mutex;
+        std::condition_variable cond;
+        std::deque<task>        tasks;
+        bool                    scheduled = false;
+        size_t                  helping   = 0u;
+
+        void schedule() noexcept;
+        void drain() noexcept;
+        [[nodiscard]] task pop() noexcept;
+
+        strand(const strand&) = delete;
+        strand& operator = (const strand&) = delete;
+    };
+}
+
+#endif
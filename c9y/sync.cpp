@@ -33,7 +33,7 @@
 namespace c9y
 {
     std::mutex tasks_mutex;
-    std::map<std::thread::id, std::vector<std::function<void ()>>> tasks;
+    std::map<std::thread::id, std::vector<task>> tasks;
     std::atomic<std::thread::id> main_thread_id;
 
     void set_main_thread_id(const std::thread::id& id) noexcept
@@ -46,19 +46,19 @@ namespace c9y
         return main_thread_id;
     }
 
-    void _sync(const std::thread::id& thread, const std::function<void()>& func) noexcept
+    void _sync(const std::thread::id& thread, task func) noexcept
     {
         assert(func);
         std::scoped_lock<std::mutex> sl(tasks_mutex);
-        tasks[thread].push_back(func);
+        tasks[thread].push_back(std::move(func));
     }
 
-    void _sync(once_tag& tag, const std::thread::id& thread, const std::function<void()>& func) noexcept
+    void _sync(once_tag& tag, const std::thread::id& thread, task func) noexcept
     {
         assert(func);
         if (tag.active.exchange(true) == false)
         {
-            _sync(thread, [&tag, func]() {
+            _sync(thread, [&tag, func = std::move(func)]() mutable {
                 try
                 {
                     func();
@@ -73,30 +73,30 @@ namespace c9y
         }
     }
 
-    void delay(const std::function<void()>& func) noexcept
+    void delay(task func) noexcept
     {
-        _sync(std::this_thread::get_id(), func);
+        _sync(std::this_thread::get_id(), std::move(func));
     }
 
-    void delay(once_tag& tag, const std::function<void()>& func) noexcept
+    void delay(once_tag& tag, task func) noexcept
     {
-        _sync(tag, std::this_thread::get_id(), func);
+        _sync(tag, std::this_thread::get_id(), std::move(func));
     }
 
-    void sync(const std::function<void()>& func) noexcept
+    void sync(task func) noexcept
     {
         assert(main_thread_id != std::thread::id());
-        sync(main_thread_id, func);
+        sync(main_thread_id, std::move(func));
     }
 
-    void sync(once_tag& tag, const std::function<void()>& func) noexcept
+    void sync(once_tag& tag, task func) noexcept
     {
         assert(func);
         assert(main_thread_id != std::thread::id());
-        sync(tag, main_thread_id, func);
+        sync(tag, main_thread_id, std::move(func));
     }
 
-    void sync(const std::thread::id& thread, const std::function<void()>& func) noexcept
+    void sync(const std::thread::id& thread, task func) noexcept
     {
         assert(func);
         if (thread == std::this_thread::get_id())
@@ -112,11 +112,11 @@ namespace c9y
         }
         else
         {
-            _sync(thread, func);
+            _sync(thread, std::move(func));
         }
     }
 
-    void sync(once_tag& tag, const std::thread::id& thread, const std::function<void()>& func) noexcept
+    void sync(once_tag& tag, const std::thread::id& thread, task func) noexcept
     {
         assert(func);
         if (thread == std::this_thread::get_id())
@@ -133,15 +133,15 @@ namespace c9y
         }
         else
         {
-            _sync(tag, thread, func);
+            _sync(tag, thread, std::move(func));
         }
     }
 
-    std::vector<std::function<void()>> get_this_threads_tasks() noexcept
+    std::vector<task> get_this_threads_tasks() noexcept
     {
         auto lock = std::scoped_lock<std::mutex>{tasks_mutex};
 
-        auto this_threads_tasks = std::vector<std::function<void ()>>();
+        auto this_threads_tasks = std::vector<task>();
         std::swap(tasks[std::this_thread::get_id()], this_threads_tasks);
 
         return this_threads_tasks;
@@ -149,7 +149,7 @@ namespace c9y
 
     void sync_point() noexcept
     {
-        for (const auto& task : get_this_threads_tasks())
+        for (auto& task : get_this_threads_tasks())
         {
             try
             {
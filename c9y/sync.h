@@ -27,8 +27,10 @@
 #include <thread>
 #include <future>
 #include <functional>
+#include <type_traits>
 
 #include "defines.h"
+#include "task.h"
 
 namespace c9y
 {
@@ -64,7 +66,7 @@ namespace c9y
     //! future that can handle the exception.
     //!
     //! @see sync_point
-    C9Y_EXPORT void sync(const std::thread::id& thread, const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void sync(const std::thread::id& thread, task func) noexcept;
 
     //! Queue action to be exectued by the given thread.
     //!
@@ -77,7 +79,7 @@ namespace c9y
     //! future that can handle the exception.
     //!
     //! @see sync_point
-    C9Y_EXPORT void sync(once_tag& tag, const std::thread::id& thread, const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void sync(once_tag& tag, const std::thread::id& thread, task func) noexcept;
 
     //! Queue action to be executed by the main thread.
     //!
@@ -89,7 +91,7 @@ namespace c9y
     //!
     //! @see set_main_thread_id
     //! @see sync_point
-    C9Y_EXPORT void sync(const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void sync(task func) noexcept;
 
     //! Queue action to be executed by the main thread.
     //!
@@ -102,7 +104,9 @@ namespace c9y
     //!
     //! @see set_main_thread_id
     //! @see sync_point
-    C9Y_EXPORT void sync(once_tag& tag, const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void sync(once_tag& tag, task func) noexcept;
+
+    template <typename T> using SyncFunc = T (*) ();
 
     //! Queue action to be exectued by the given thread with result.
     //!
@@ -110,13 +114,13 @@ namespace c9y
     //! @param func the fuction to call in the give thread
     //!
     //! @see sync_point
-    template <typename T>
-    [[nodiscard]] std::future<T> sync(const std::thread::id& thread, const std::function<T()>& func) noexcept
+    template <typename T, typename Func = SyncFunc<T>>
+    [[nodiscard]] std::future<T> sync(const std::thread::id& thread, Func&& func) noexcept
     {
-        auto task = std::make_shared<std::packaged_task<T()>>(func);
-        auto future = task->get_future();
-        sync(thread, [task] () mutable {
-            (*task)();
+        auto ptask  = std::packaged_task<T()>(std::forward<Func>(func));
+        auto future = ptask.get_future();
+        sync(thread, [ptask = std::move(ptask)] () mutable {
+            ptask();
         });
         return future;
     }
@@ -128,13 +132,13 @@ namespace c9y
     //! @param func the fuction to call in the give thread
     //!
     //! @see sync_point
-    template <typename T>
-    [[nodiscard]] std::future<T> sync(once_tag& tag, const std::thread::id& thread, const std::function<T()>& func) noexcept
+    template <typename T, typename Func = SyncFunc<T>>
+    [[nodiscard]] std::future<T> sync(once_tag& tag, const std::thread::id& thread, Func&& func) noexcept
     {
-        auto task = std::make_shared<std::packaged_task<T()>>(func);
-        auto future = task->get_future();
-        sync(tag, thread, [task] () mutable {
-            (*task)();
+        auto ptask  = std::packaged_task<T()>(std::forward<Func>(func));
+        auto future = ptask.get_future();
+        sync(tag, thread, [ptask = std::move(ptask)] () mutable {
+            ptask();
         });
         return future;
     }
@@ -145,10 +149,10 @@ namespace c9y
     //!
     //! @see set_main_thread_id
     //! @see sync_point
-    template <typename T>
-    [[nodiscard]] std::future<T> sync(const std::function<T()>& func) noexcept
+    template <typename T, typename Func = SyncFunc<T>>
+    [[nodiscard]] std::future<T> sync(Func&& func) noexcept
     {
-        return sync<T>(get_main_thread_id(), func);
+        return sync<T>(get_main_thread_id(), std::forward<Func>(func));
     }
 
     //! Queue task to be executed on the main thread with result.
@@ -158,10 +162,10 @@ namespace c9y
     //!
     //! @see set_main_thread_id
     //! @see sync_point
-    template <typename T>
-    [[nodiscard]] std::future<T> sync(once_tag& tag, const std::function<T()>& func) noexcept
+    template <typename T, typename Func = SyncFunc<T>>
+    [[nodiscard]] std::future<T> sync(once_tag& tag, Func&& func) noexcept
     {
-        return sync<T>(tag, get_main_thread_id(), func);
+        return sync<T>(tag, get_main_thread_id(), std::forward<Func>(func));
     }
 
     //! Delay action until next time tick is called on this thread.
@@ -173,7 +177,7 @@ namespace c9y
     //! future that can handle the exception.
     //!
     //! @see sync_point
-    C9Y_EXPORT void delay(const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void delay(task func) noexcept;
 
     //! Delay action until next time tick is called on this thread.
     //!
@@ -185,7 +189,7 @@ namespace c9y
     //! future that can handle the exception.
     //!
     //! @see sync_point
-    C9Y_EXPORT void delay(once_tag& tag, const std::function<void ()>& func) noexcept;
+    C9Y_EXPORT void delay(once_tag& tag, task func) noexcept;
 
     //! Execute alle queueed tasks for this thread.
     //!
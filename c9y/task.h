@@ -0,0 +1,204 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_TASK_H_
+#define _C9Y_TASK_H_
+
+#include "defines.h"
+
+#include <cstddef>
+#include <new>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace c9y
+{
+    template <typename T>
+    struct _is_function : std::false_type {};
+
+    template <typename Signature>
+    struct _is_function<std::function<Signature>> : std::true_type {};
+
+    //! Task
+    //!
+    //! A task is a type erased, move only callable with the signature `void ()`.
+    //! In contrast to std::function, it can hold callables that can not be
+    //! copied, such as lambdas that capture a std::unique_ptr or a std::promise.
+    //!
+    //! Callables that are at most buffer_size bytes large and can be moved
+    //! without throwing are stored in an inline buffer. Only larger callables
+    //! are allocated on the heap.
+    class task
+    {
+    public:
+        //! The size of the inline buffer.
+        static constexpr size_t buffer_size = 64u - sizeof(void*);
+
+        //! Create an empty task.
+        //! @{
+        task() noexcept = default;
+        task(std::nullptr_t) noexcept {}
+        //! @}
+
+        //! Create a task from a callable.
+        //!
+        //! @param func the callable to wrap
+        //!
+        //! @note Wrapping an empty function pointer or std::function results
+        //! in an empty task.
+        template <typename Callable>
+        requires (!std::is_same_v<std::remove_cvref_t<Callable>, task>) && std::is_invocable_v<std::decay_t<Callable>&>
+        task(Callable&& func)
+        {
+            using Func = std::decay_t<Callable>;
+
+            if constexpr (std::is_pointer_v<Func> || _is_function<Func>::value)
+            {
+                if (!func)
+                {
+                    return;
+                }
+            }
+
+            if constexpr (stored_inline<Func>)
+            {
+                ::new (static_cast<void*>(buffer)) Func(std::forward<Callable>(func));
+                ops = &inline_operations<Func>;
+            }
+            else
+            {
+                ::new (static_cast<void*>(buffer)) Func*(new Func(std::forward<Callable>(func)));
+                ops = &heap_operations<Func>;
+            }
+        }
+
+        //! Move Constructor
+        task(task&& other) noexcept
+        {
+            take(other);
+        }
+
+        //! Destructor
+        ~task()
+        {
+            reset();
+        }
+
+        //! Move Assignment
+        task& operator = (task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        //! Check if the task holds a callable.
+        explicit operator bool () const noexcept
+        {
+            return ops != nullptr;
+        }
+
+        //! Invoke the callable.
+        //!
+        //! @throws std::bad_function_call if the task is empty.
+        void operator () ()
+        {
+            if (ops == nullptr)
+            {
+                throw std::bad_function_call();
+            }
+            ops->invoke(buffer);
+        }
+
+    private:
+        struct operations
+        {
+            void (*invoke)(void* storage);
+            void (*move)(void* from, void* to) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template <typename Func>
+        static constexpr bool stored_inline = sizeof(Func) <= buffer_size &&
+                                              alignof(Func) <= alignof(std::max_align_t) &&
+                                              std::is_nothrow_move_constructible_v<Func>;
+
+        template <typename Func>
+        static constexpr operations inline_operations = {
+            [] (void* storage) {
+                (*static_cast<Func*>(storage))();
+            },
+            [] (void* from, void* to) noexcept {
+                auto func = static_cast<Func*>(from);
+                ::new (to) Func(std::move(*func));
+                func->~Func();
+            },
+            [] (void* storage) noexcept {
+                static_cast<Func*>(storage)->~Func();
+            }
+        };
+
+        template <typename Func>
+        static constexpr operations heap_operations = {
+            [] (void* storage) {
+                (**static_cast<Func**>(storage))();
+            },
+            [] (void* from, void* to) noexcept {
+                ::new (to) Func*(*static_cast<Func**>(from));
+            },
+            [] (void* storage) noexcept {
+                delete *static_cast<Func**>(storage);
+            }
+        };
+
+        alignas(std::max_align_t) std::byte buffer[buffer_size];
+        const operations*                    ops = nullptr;
+
+        void take(task& other) noexcept
+        {
+            if (other.ops != nullptr)
+            {
+                other.ops->move(other.buffer, buffer);
+                ops       = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        void reset() noexcept
+        {
+            if (ops != nullptr)
+            {
+                ops->destroy(buffer);
+                ops = nullptr;
+            }
+        }
+
+        task(const task&) = delete;
+        task& operator = (const task&) = delete;
+    };
+}
+
+#endif
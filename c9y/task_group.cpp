@@ -0,0 +1,78 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "task_group.h"
+
+namespace c9y
+{
+    task_group::task_group(task_pool& p) noexcept
+    : pool(p) {}
+
+    task_group::~task_group()
+    {
+        wait();
+    }
+
+    void task_group::wait() noexcept
+    {
+        // the fiber parks and frees the worker, instead of helping in run_until
+        if (fiber::current())
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            fibers.wait(lock, [this] {return pending == 0;});
+            return;
+        }
+
+        if (pool.is_worker())
+        {
+            pool.run_until([this] () {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                return pending == 0;
+            });
+            return;
+        }
+
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        cond.wait(lock, [this] {return pending == 0;});
+    }
+
+    void task_group::started() noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        pending++;
+    }
+
+    void task_group::finished() noexcept
+    {
+        // The waiter only sees pending reach zero under the lock, so the
+        // group is not destroyed before the notifications are done.
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        if (--pending == 0)
+        {
+            cond.notify_all();
+            fibers.notify_all();
+            // wake the worker that waits in run_until
+            pool.notify_run_until();
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef _C9Y_TASK_GROUP_H_
+#define _C9Y_TASK_GROUP_H_
+
+#include "defines.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <utility>
+
+#include "task_pool.h"
+#include "waiter.h"
+
+namespace c9y
+{
+    //! Task Group
+    //!
+    //! A task group runs tasks on a task pool and allows to wait for exactly
+    //! these tasks. In contrast to task_pool::flush, waiting on a group is
+    //! not affected by unrelated work on the same pool.
+    class C9Y_EXPORT task_group
+    {
+    public:
+        //! Create a task group bound to a task pool.
+        //!
+        //! @param pool the pool to execute the tasks on
+        explicit task_group(task_pool& pool) noexcept;
+
+        //! Destructor
+        //!
+        //! The destructor waits for all tasks of the group.
+        ~task_group();
+
+        //! Run a task as part of the group.
+        //!
+        //! @param func the function to execute
+        template <typename Callable>
+        void run(Callable&& func) noexcept
+        {
+            started();
+            pool.enqueue([this, func = std::forward<Callable>(func)] () mutable {
+                try
+                {
+                    func();
+                }
+                catch (...)
+                {
+                    finished();
+                    throw;
+                }
+                finished();
+            });
+        }
+
+        //! Wait for all tasks of the group.
+        //!
+        //! When called from a worker of the pool, the worker helps executing
+        //! pending tasks while it waits. A fiber parks until the last task
+        //! finished.
+        void wait() noexcept;
+
+    private:
+        task_pool&              pool;
+        std::mutex              mutex;
+        std::condition_variable cond;
+        _wait_list              fibers;
+        size_t                  pending = 0u;
+
+        void started() noexcept;
+        void finished() noexcept;
+
+        task_group(const task_group&) = delete;
+        task_group& operator = (const task_group&) = delete;
+    };
+}
+
+#endif
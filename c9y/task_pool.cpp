@@ -23,57 +23,1226 @@
 
 #include "task_pool.h"
 
+#include <random>
+#include <algorithm>
+#include <utility>
+
 #include "exceptions.h"
+#include "utils.h"
 
 using namespace std::literals::chrono_literals;
 
 namespace c9y
 {
+    thread_local task_pool* this_task_pool    = nullptr;
+    thread_local size_t     this_worker_index = 0u;
+    thread_local task_pool* this_timer_pool   = nullptr;
+
+    //! The maximum number of tasks a worker moves from the injection queue to it's deque.
+    constexpr size_t max_injected_batch = 32u;
+
+    //! The number of pauses after which a spinning worker starts yielding.
+    constexpr unsigned int max_spin_backoff = 64u;
+
+    //! The longest time run_until waits before checking it's condition again.
+    constexpr auto max_run_until_wait = 1ms;
+
+    //! The time between two checks whether an elastic pool needs to grow.
+    constexpr auto grow_check_interval = 100us;
+
+    //! The number of consecutive checks with queued tasks and no idle worker before an elastic pool grows.
+    constexpr size_t grow_checks = 3u;
+
+    //! Decrement a counter that is only written under a lock.
+    //!
+    //! A plain store avoids the cost of a read-modify-write; producers
+    //! increment with fetch_add, since they need the full fence, see wake.
+    void decrement(std::atomic<size_t>& counter, size_t count = 1u) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) - count, std::memory_order_relaxed);
+    }
+
+    size_t random_victim(size_t count) noexcept
+    {
+        thread_local auto rng = std::minstd_rand{static_cast<unsigned int>(std::hash<std::thread::id>{}(std::this_thread::get_id()))};
+        return rng() % count;
+    }
+
     task_pool::task_pool(size_t concurency) noexcept
-    : pool([this] () {thread_func();}, concurency) {}
+    : task_pool(task_pool_options{.concurency = concurency}) {}
+
+    task_pool::task_pool(const task_pool_options& o) noexcept
+    : options(o), worker_queues(o.concurency), scheduler(std::make_shared<fiber_scheduler>())
+    {
+        scheduler->pool = this;
+
+        auto cpus = get_placement_cpus(options.placement, options.concurency);
+        if (!cpus.empty())
+        {
+            node_count = get_numa_node_count();
+            for (size_t node = 0; node < node_count; node++)
+            {
+                for (auto cpu : get_numa_node_cpus(node))
+                {
+                    if (cpu >= cpu_nodes.size())
+                    {
+                        cpu_nodes.resize(cpu + 1u, 0u);
+                    }
+                    cpu_nodes[cpu] = node;
+                }
+            }
+
+            for (size_t i = 0; i < cpus.size(); i++)
+            {
+                worker_queues[i].cpu  = cpus[i];
+                worker_queues[i].node = cpus[i] < cpu_nodes.size() ? cpu_nodes[cpus[i]] : 0u;
+            }
+        }
+
+        injected       = std::vector<std::deque<task>>(lane_count + node_count - 1u);
+        injected_count = std::vector<std::atomic<size_t>>(lane_count + node_count - 1u);
+
+        spawn_workers(std::max(options.min_concurency, options.hot_workers));
+    }
 
     task_pool::~task_pool()
     {
-        tasks.stop();
-        tasks_in_flight = 0; // needed to release flush
+        // stop the timers first, so that they do not enqueue into a stopped pool
+        {
+            auto lock = std::unique_lock<std::mutex>{timer_mutex};
+            timer_stopped = true;
+        }
+        timer_cond.notify_all();
+        if (timer_thread.joinable())
+        {
+            timer_thread.join();
+        }
+
+        // a parked fiber that is woken from now on stays where it is
+        {
+            auto lock = std::unique_lock<std::mutex>{scheduler->mutex};
+            scheduler->pool = nullptr;
+        }
+
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            stopped = true;
+        }
+        for (auto& worker : worker_queues)
+        {
+            worker.cond.notify_all();
+        }
+
+        {
+            auto lock = std::unique_lock<std::mutex>{capacity_mutex};
+        }
+        capacity_cond.notify_all();
+
+        // release flush
+        {
+            auto lock = std::unique_lock<std::mutex>{flush_mutex};
+        }
         flush_cv.notify_all();
+
+        // spawn_workers checks stopped under threads_mutex, after this no
+        // thread is spawned; retiring threads also need the mutex to exit
+        auto retired = std::vector<jthread>{};
+        {
+            auto lock = std::unique_lock<std::mutex>{threads_mutex};
+            retired = std::move(retired_threads);
+        }
+        for (auto& worker : worker_queues)
+        {
+            if (worker.thread.joinable())
+            {
+                worker.thread.join();
+            }
+        }
+        for (auto& thread : retired)
+        {
+            thread.join();
+        }
+    }
+
+    void task_pool::enqueue(task func) noexcept
+    {
+        wait_for_capacity(std::nullopt);
+        push(priority::normal, std::move(func));
+    }
+
+    void task_pool::enqueue(priority prio, task func) noexcept
+    {
+        wait_for_capacity(std::nullopt);
+        push(prio, std::move(func));
+    }
+
+    void task_pool::enqueue(size_t key, task func) noexcept
+    {
+        wait_for_capacity(std::nullopt);
+
+        task_created(1u);
+        auto index = key_owner(key);
+        {
+            auto& owner = worker_queues[index];
+            auto lock = std::unique_lock<std::mutex>{owner.mutex};
+            owner.keyed.push_back(std::move(func));
+            owner.size++;
+        }
+        wake_owner(index);
+    }
+
+    size_t task_pool::key_owner(size_t key) const noexcept
+    {
+        // pick the n-th running worker, so that keys do not land on retired slots
+        auto active = active_count.load();
+        if (active != 0u)
+        {
+            auto n = key % active;
+            for (size_t index = 0; index < worker_queues.size(); index++)
+            {
+                if (worker_queues[index].active && n-- == 0u)
+                {
+                    return index;
+                }
+            }
+        }
+        // no thread runs or the workers changed while searching
+        return key % worker_queues.size();
+    }
+
+    bool task_pool::try_enqueue(task&& func) noexcept
+    {
+        if (options.capacity != 0u && !is_exempt() && queued() >= options.capacity)
+        {
+            return false;
+        }
+
+        push(priority::normal, std::move(func));
+        return true;
+    }
+
+    bool task_pool::enqueue_for(std::chrono::steady_clock::duration timeout, task&& func) noexcept
+    {
+        if (!wait_for_capacity(std::chrono::steady_clock::now() + timeout))
+        {
+            return false;
+        }
+
+        push(priority::normal, std::move(func));
+        return true;
+    }
+
+    void task_pool::push(priority prio, task func) noexcept
+    {
+        task_created(1u);
+
+        auto local = prio == priority::normal ? this_worker() : nullptr;
+        if (local)
+        {
+            auto lock = std::unique_lock<std::mutex>{local->mutex};
+            if (options.lifo_limit != 0u)
+            {
+                // the new task takes the slot, the previous one moves to the deque
+                std::swap(local->next, func);
+            }
+            if (func)
+            {
+                local->tasks.push_back(std::move(func));
+            }
+            local->size++;
+        }
+        else
+        {
+            auto lane = lane_index(prio, current_node());
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            injected[lane].push_back(std::move(func));
+            injected_count[lane]++;
+        }
+
+        wake(1u);
+    }
+
+    bool task_pool::is_exempt() const noexcept
+    {
+        return is_worker() || this_timer_pool == this;
+    }
+
+    bool task_pool::wait_for_capacity(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+    {
+        if (options.capacity == 0u || is_exempt() || queued() < options.capacity)
+        {
+            return true;
+        }
+
+        auto lock = std::unique_lock<std::mutex>{capacity_mutex};
+        producers_waiting++;
+        auto has_capacity = [&] {return stopped || queued() < options.capacity;};
+        auto result = true;
+        if (deadline)
+        {
+            result = capacity_cond.wait_until(lock, *deadline, has_capacity);
+        }
+        else
+        {
+            capacity_cond.wait(lock, has_capacity);
+        }
+        producers_waiting--;
+        return result;
+    }
+
+    void task_pool::enqueue_bulk(std::vector<task>& tasks) noexcept
+    {
+        enqueue_bulk(std::make_move_iterator(tasks.begin()), std::make_move_iterator(tasks.end()));
+    }
+
+    void task_pool::enqueue_after(std::chrono::steady_clock::duration delay, task func) noexcept
+    {
+        enqueue_at(std::chrono::steady_clock::now() + delay, std::move(func));
+    }
+
+    void task_pool::enqueue_at(std::chrono::steady_clock::time_point time, task func) noexcept
+    {
+        auto notify = false;
+        {
+            auto lock = std::unique_lock<std::mutex>{timer_mutex};
+            if (timer_stopped)
+            {
+                return;
+            }
+
+            start_timer_thread();
+
+            auto sequence = timer_sequence++;
+            timers.push_back({time, sequence, std::move(func)});
+            std::push_heap(begin(timers), end(timers), std::greater<>{});
+
+            // the timer thread only needs to wake up if the next deadline changed
+            notify = timers.front().sequence == sequence;
+        }
+
+        if (notify)
+        {
+            timer_cond.notify_one();
+        }
+    }
+
+    void task_pool::enqueue_every(std::chrono::steady_clock::duration period, task func, stop_token token) noexcept
+    {
+        // shared, so that the timer task stays small enough to be stored inline
+        auto shared = std::make_shared<task>(std::move(func));
+        enqueue_recurring(std::move(shared), std::chrono::steady_clock::now() + period, period, std::move(token));
+    }
+
+    void task_pool::enqueue_recurring(std::shared_ptr<task> func, std::chrono::steady_clock::time_point time,
+                                      std::chrono::steady_clock::duration period, stop_token token) noexcept
+    {
+        enqueue_at(time, [this, func, time, period, token] () mutable {
+            if (token.stop_requested())
+            {
+                return;
+            }
+
+            (*func)();
+
+            auto next = time + period;
+            auto now  = std::chrono::steady_clock::now();
+            while (next <= now)
+            {
+                next += period;
+            }
+            enqueue_recurring(std::move(func), next, period, std::move(token));
+        });
+    }
+
+    void task_pool::timer_func() noexcept
+    {
+        // due timers are enqueued regardless of the capacity
+        this_timer_pool = this;
+
+        auto lock = std::unique_lock<std::mutex>{timer_mutex};
+        while (!timer_stopped)
+        {
+            if (grow_check && *grow_check <= std::chrono::steady_clock::now())
+            {
+                grow_check = std::nullopt;
+                lock.unlock();
+                auto again = check_growth();
+                lock.lock();
+                if (again)
+                {
+                    grow_check = std::chrono::steady_clock::now() + grow_check_interval;
+                }
+                continue;
+            }
+
+            if (timers.empty() && !grow_check)
+            {
+                timer_cond.wait(lock);
+                continue;
+            }
+
+            auto time = timers.empty() ? *grow_check : timers.front().time;
+            if (grow_check)
+            {
+                time = std::min(time, *grow_check);
+            }
+            if (std::chrono::steady_clock::now() < time)
+            {
+                timer_cond.wait_until(lock, time);
+                continue;
+            }
+
+            // enqueue all due timers without holding the lock
+            auto due = std::vector<task>{};
+            auto now = std::chrono::steady_clock::now();
+            while (!timers.empty() && timers.front().time <= now)
+            {
+                std::pop_heap(begin(timers), end(timers), std::greater<>{});
+                due.push_back(std::move(timers.back().func));
+                timers.pop_back();
+            }
+
+            lock.unlock();
+            enqueue_bulk(due);
+            lock.lock();
+        }
     }
 
-    void task_pool::enqueue(const std::function<void ()>& func) noexcept
+    void task_pool::start_timer_thread() noexcept
     {
-        tasks_in_flight++;
-        tasks.push(func);
+        if (!timer_thread.joinable())
+        {
+            timer_thread = jthread([this] () {timer_func();});
+        }
     }
 
     void task_pool::flush() noexcept
     {
         auto lock = std::unique_lock<std::mutex>{flush_mutex};
 
-        if (tasks_in_flight == 0)
+        if (in_flight() == 0)
+        {
+            return;
+        }
+
+        flush_waiting++;
+        flush_cv.wait(lock, [&]{return stopped || in_flight() == 0;});
+        flush_waiting--;
+    }
+
+    void task_pool::run_until(const std::function<bool ()>& done) noexcept
+    {
+        // a fiber parks, instead of running tasks on it's small stack
+        if (fiber::current() || this_task_pool != this)
         {
+            executor::run_until(done);
             return;
         }
 
-        flush_cv.wait(lock, [&]{return tasks_in_flight == 0;});
+        auto wait_time = std::chrono::microseconds(10);
+        while (true)
+        {
+            // a notification after this point is not lost
+            auto epoch = run_epoch.load();
+            if (done())
+            {
+                return;
+            }
+
+            if (auto task = next_task(this_worker_index))
+            {
+                execute(task);
+                wait_time = std::chrono::microseconds(10);
+                continue;
+            }
+
+            auto& self = worker_queues[this_worker_index];
+            auto lock  = std::unique_lock<std::mutex>{mutex};
+            self.helping = true;
+            helping++;
+            if (run_epoch == epoch)
+            {
+                park(lock, this_worker_index, std::chrono::steady_clock::now() + wait_time);
+            }
+            self.helping = false;
+            helping--;
+
+            wait_time = std::min<std::chrono::microseconds>(wait_time * 2, max_run_until_wait);
+        }
+    }
+
+    void task_pool::notify_run_until() noexcept
+    {
+        executor::notify_run_until();
+
+        run_epoch++;
+        if (helping != 0)
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            for (size_t index = 0; index < worker_queues.size(); index++)
+            {
+                auto& worker = worker_queues[index];
+                if (worker.helping && worker.parked)
+                {
+                    unpark(index);
+                    worker.cond.notify_one();
+                }
+            }
+        }
+    }
+
+    bool task_pool::is_worker() const noexcept
+    {
+        return this_task_pool == this;
+    }
+
+    std::optional<size_t> task_pool::worker_index() noexcept
+    {
+        if (this_task_pool == nullptr)
+        {
+            return std::nullopt;
+        }
+        return this_worker_index;
+    }
+
+    size_t task_pool::get_concurency() const noexcept
+    {
+        return active_count;
+    }
+
+    task_pool::worker* task_pool::this_worker() noexcept
+    {
+        if (this_task_pool == this)
+        {
+            return &worker_queues[this_worker_index];
+        }
+        return nullptr;
+    }
+
+    void task_pool::wake(size_t count) noexcept
+    {
+        if (sleeping != 0)
+        {
+            // Taking the worker out of the idle list under the lock ensures
+            // that it is either waiting or will see the task, and that the
+            // next wake does not pick a worker that was already woken.
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            while (count != 0 && !idle.empty())
+            {
+                // the worker that parked last has the warmest cache
+                auto index = idle.back();
+                unpark(index);
+                worker_queues[index].cond.notify_one();
+                count--;
+            }
+        }
+
+        if (count != 0 && active_count < options.concurency)
+        {
+            grow();
+        }
+    }
+
+    void task_pool::wake_owner(size_t index) noexcept
+    {
+        if (sleeping != 0)
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            auto& owner = worker_queues[index];
+            if (owner.parked)
+            {
+                unpark(index);
+                owner.cond.notify_one();
+                return;
+            }
+        }
+
+        // the owner is busy, an idle worker may take the task instead
+        wake(1u);
     }
 
-    void task_pool::thread_func() noexcept
+    bool task_pool::park(std::unique_lock<std::mutex>& lock, size_t index, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
     {
-        while (auto task = tasks.pop_wait())
+        auto& self = worker_queues[index];
+        self.parked = true;
+        idle.push_back(index);
+        sleeping++;
+
+        auto woken = true;
+        while (self.parked && !stopped && !has_work())
         {
-            try
+            if (!deadline)
             {
-                (*task)();
+                self.cond.wait(lock);
             }
-            catch (...)
+            else if (self.cond.wait_until(lock, *deadline) == std::cv_status::timeout)
             {
-                c9y::unhandled_exception();
+                woken = !self.parked || stopped || has_work();
+                break;
             }
+        }
+
+        unpark(index);
+        return woken;
+    }
+
+    void task_pool::unpark(size_t index) noexcept
+    {
+        auto& worker = worker_queues[index];
+        if (worker.parked)
+        {
+            worker.parked = false;
+            idle.erase(std::find(begin(idle), end(idle), index));
+            sleeping--;
+        }
+    }
+
+    void task_pool::grow() noexcept
+    {
+        if (active_count == 0u)
+        {
+            // there is no thread that could run the task
+            spawn_workers(1u);
+            return;
+        }
+
+        // the timer thread checks if the backlog persists
+        if (!grow_armed && !grow_armed.exchange(true))
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{timer_mutex};
+                if (timer_stopped)
+                {
+                    return;
+                }
+                start_timer_thread();
+                grow_check = std::chrono::steady_clock::now() + grow_check_interval;
+            }
+            timer_cond.notify_one();
+        }
+    }
 
-            if (--tasks_in_flight == 0)
+    bool task_pool::check_growth() noexcept
+    {
+        if (!has_work())
+        {
+            backlog_checks = 0u;
+            // a task enqueued after disarming arms the check again
+            grow_armed = false;
+            if (!has_work() || grow_armed.exchange(true))
             {
-                flush_cv.notify_all();
+                return false;
             }
         }
+
+        if (sleeping != 0)
+        {
+            // an idle worker will take the tasks
+            backlog_checks = 0u;
+            return true;
+        }
+
+        if (++backlog_checks < grow_checks)
+        {
+            return true;
+        }
+
+        backlog_checks = 0u;
+        auto active = active_count.load();
+        if (active < options.concurency)
+        {
+            spawn_workers(std::min(queued(), options.concurency - active));
+        }
+
+        if (active_count >= options.concurency)
+        {
+            grow_armed = false;
+            return false;
+        }
+        return true;
+    }
+
+    task task_pool::pop_local(size_t index) noexcept
+    {
+        auto& local = worker_queues[index];
+        auto lock = std::unique_lock<std::mutex>{local.mutex};
+        if (local.next)
+        {
+            if (local.streak < options.lifo_limit)
+            {
+                local.streak++;
+                decrement(local.size);
+                return std::exchange(local.next, nullptr);
+            }
+
+            // the chain had it's share, let the older tasks run first
+            // and allow the other workers to steal the continuation
+            local.tasks.push_front(std::exchange(local.next, nullptr));
+        }
+        local.streak = 0u;
+
+        if (!local.tasks.empty())
+        {
+            auto task = std::move(local.tasks.back());
+            local.tasks.pop_back();
+            decrement(local.size);
+            return task;
+        }
+
+        // keyed tasks are served in order, so that older ones can not starve
+        if (!local.keyed.empty())
+        {
+            auto task = std::move(local.keyed.front());
+            local.keyed.pop_front();
+            decrement(local.size);
+            return task;
+        }
+
+        return nullptr;
+    }
+
+    size_t task_pool::current_node() const noexcept
+    {
+        if (node_count == 1u)
+        {
+            return 0u;
+        }
+
+        if (is_worker())
+        {
+            return worker_queues[this_worker_index].node;
+        }
+
+        auto cpu = get_current_cpu();
+        if (cpu && *cpu < cpu_nodes.size())
+        {
+            return cpu_nodes[*cpu];
+        }
+        return 0u;
+    }
+
+    size_t task_pool::lane_index(priority prio, size_t node) const noexcept
+    {
+        // the normal lanes of the nodes other than the first follow the fixed lanes
+        if (prio == priority::normal && node != 0u)
+        {
+            return lane_count + node - 1u;
+        }
+        return static_cast<size_t>(prio);
+    }
+
+    task task_pool::pop_injected(priority prio, size_t index) noexcept
+    {
+        if (prio != priority::normal)
+        {
+            return pop_lane(static_cast<size_t>(prio), index, false);
+        }
+
+        // prefer the tasks enqueued on the worker's own node
+        auto node = worker_queues[index].node;
+        for (size_t i = 0; i < node_count; i++)
+        {
+            if (auto task = pop_lane(lane_index(priority::normal, (node + i) % node_count), index, i == 0))
+            {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    task task_pool::pop_lane(size_t l, size_t index, bool batch) noexcept
+    {
+        auto& queue = injected[l];
+
+        if (injected_count[l] == 0)
+        {
+            return nullptr;
+        }
+
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        if (queue.empty())
+        {
+            return nullptr;
+        }
+
+        auto task = std::move(queue.front());
+        queue.pop_front();
+        decrement(injected_count[l]);
+
+        // Take a fair share of the remaining normal tasks, so that the next
+        // tasks do not need to go through the contended injection queue.
+        // The other lanes stay shared, so that their priority is honored.
+        if (batch)
+        {
+            auto workers = std::max(worker_queues.size() / node_count, size_t{1});
+            auto count   = std::min(queue.size() / workers, max_injected_batch);
+            if (count != 0)
+            {
+                auto& local = worker_queues[index];
+                auto local_lock = std::unique_lock<std::mutex>{local.mutex};
+                for (size_t i = 0; i < count; i++)
+                {
+                    local.tasks.push_front(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                decrement(injected_count[l], count);
+                local.size += count;
+            }
+        }
+
+        return task;
+    }
+
+    task task_pool::steal(size_t index) noexcept
+    {
+        auto count = worker_queues.size();
+        auto start = random_victim(count);
+        auto node  = worker_queues[index].node;
+
+        // the first pass only steals on the own node, the second from the others
+        auto passes = node_count == 1u ? 1u : 2u;
+        for (auto pass = 0u; pass < passes; pass++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                auto victim_index = (start + i) % count;
+                auto& victim      = worker_queues[victim_index];
+                if (victim_index == index || (pass == 0u) != (victim.node == node) || victim.size == 0)
+                {
+                    continue;
+                }
+
+                auto lock = std::unique_lock<std::mutex>{victim.mutex};
+                if (!victim.tasks.empty())
+                {
+                    auto task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    decrement(victim.size);
+                    return task;
+                }
+            }
+        }
+
+        // Take the keyed tasks and LIFO slots only as last resort, since they
+        // belong to their worker or are hot in it's cache. They are still
+        // stolen, so that a task that blocks on them does not deadlock.
+        for (size_t i = 0; i < count; i++)
+        {
+            auto victim_index = (start + i) % count;
+            if (victim_index == index)
+            {
+                continue;
+            }
+
+            auto& victim = worker_queues[victim_index];
+            if (victim.size == 0)
+            {
+                continue;
+            }
+
+            auto lock = std::unique_lock<std::mutex>{victim.mutex};
+            if (!victim.keyed.empty() && (victim.busy || !victim.active))
+            {
+                auto task = std::move(victim.keyed.front());
+                victim.keyed.pop_front();
+                decrement(victim.size);
+                return task;
+            }
+            if (victim.next)
+            {
+                decrement(victim.size);
+                return std::exchange(victim.next, nullptr);
+            }
+        }
+        return nullptr;
+    }
+
+    bool task_pool::spin(size_t index) noexcept
+    {
+        auto hot = index < options.hot_workers;
+        if (!hot && options.spin_duration.count() == 0)
+        {
+            return false;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + options.spin_duration;
+        auto backoff  = 1u;
+        while (!stopped)
+        {
+            if (has_work())
+            {
+                return true;
+            }
+
+            if (backoff < max_spin_backoff)
+            {
+                for (auto i = 0u; i < backoff; i++)
+                {
+                    cpu_relax();
+                }
+                backoff *= 2u;
+            }
+            else
+            {
+                std::this_thread::yield();
+                if (!hot && std::chrono::steady_clock::now() >= deadline)
+                {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    task task_pool::next_task(size_t index) noexcept
+    {
+        auto& self = worker_queues[index];
+        if (options.starvation_limit != 0 && ++self.ticks % options.starvation_limit == 0)
+        {
+            // serve the lower lanes first, so that they can not starve
+            if (auto task = pop_injected(priority::background, index))
+            {
+                return task;
+            }
+            if (auto task = pop_injected(priority::normal, index))
+            {
+                return task;
+            }
+        }
+
+        if (auto task = pop_injected(priority::high, index))
+        {
+            return task;
+        }
+        if (auto task = pop_local(index))
+        {
+            return task;
+        }
+        if (auto task = pop_injected(priority::normal, index))
+        {
+            return task;
+        }
+        if (auto task = steal(index))
+        {
+            return task;
+        }
+        return pop_injected(priority::background, index);
+    }
+
+    void task_pool::execute(task& func) noexcept
+    {
+        // the task left the queue, wake a producer waiting for capacity
+        if (producers_waiting != 0)
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{capacity_mutex};
+            }
+            capacity_cond.notify_one();
+        }
+
+        // cleared before task_done, so that the worker counts as free once
+        // the task is visibly finished; run_until nests tasks in a busy one
+        auto& self = worker_queues[this_worker_index];
+        auto outer = self.busy.load(std::memory_order_relaxed);
+        self.busy.store(true, std::memory_order_relaxed);
+
+        try
+        {
+            func();
+        }
+        catch (...)
+        {
+            c9y::unhandled_exception();
+        }
+
+        self.busy.store(outer, std::memory_order_relaxed);
+        task_done();
+    }
+
+    void task_pool::task_created(size_t count) noexcept
+    {
+        if (auto local = this_worker())
+        {
+            local->created.store(local->created.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+        else
+        {
+            external_created += count;
+        }
+    }
+
+    void task_pool::task_done() noexcept
+    {
+        if (auto local = this_worker())
+        {
+            // the seq_cst store orders the count before the check of flush_waiting
+            local->finished.store(local->finished.load(std::memory_order_relaxed) + 1u);
+        }
+        else
+        {
+            external_finished++;
+        }
+
+        if (flush_waiting != 0)
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{flush_mutex};
+            }
+            flush_cv.notify_all();
+        }
+    }
+
+    size_t task_pool::in_flight() const noexcept
+    {
+        // Every task is counted as created before it can be finished. By
+        // summing up all finished counts before the created counts, a task
+        // that moved between workers while summing can not be missed.
+        auto finished = external_finished.load();
+        for (const auto& worker : worker_queues)
+        {
+            finished += worker.finished.load();
+        }
+
+        auto created = external_created.load();
+        for (const auto& worker : worker_queues)
+        {
+            created += worker.created.load();
+        }
+
+        return created - finished;
+    }
+
+    size_t task_pool::queued() const noexcept
+    {
+        auto count = size_t{0};
+        for (const auto& c : injected_count)
+        {
+            count += c.load();
+        }
+        for (const auto& worker : worker_queues)
+        {
+            count += worker.size.load();
+        }
+        return count;
+    }
+
+    bool task_pool::has_work() const noexcept
+    {
+        for (const auto& c : injected_count)
+        {
+            if (c != 0)
+            {
+                return true;
+            }
+        }
+        for (const auto& worker : worker_queues)
+        {
+            if (worker.size != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void task_pool::enqueue_fiber(task func, size_t stack_size) noexcept
+    {
+        // the fiber counts as one task until it finishes, also while it waits
+        task_created(1u);
+        auto f = std::make_shared<fiber>(std::move(func), stack_size);
+        enqueue([this, f] () {
+            resume_fiber(f);
+        });
+    }
+
+    void task_pool::resume_fiber(std::shared_ptr<fiber> f) noexcept
+    {
+        if (f->resume())
+        {
+            task_done();
+            return;
+        }
+
+        // the fiber is suspended and off the stack, it may now be resumed elsewhere
+        if (!f->is_parked())
+        {
+            enqueue_after(f->get_delay(), [this, f] () {
+                resume_fiber(f);
+            });
+            return;
+        }
+
+        if (auto deadline = f->get_deadline())
+        {
+            enqueue_at(*deadline, [weak = std::weak_ptr<fiber>{f}] () {
+                if (auto f = weak.lock())
+                {
+                    f->wake();
+                }
+            });
+        }
+
+        // The waker may hold a lock of the primitive, so the fiber goes
+        // past the capacity limit; it is already counted as a task.
+        f->on_wake([s = scheduler, f] () {
+            auto lock = std::unique_lock<std::mutex>{s->mutex};
+            if (auto pool = s->pool)
+            {
+                pool->push(priority::normal, [pool, f] () {
+                    pool->resume_fiber(f);
+                });
+            }
+        });
+    }
+
+    bool task_pool::is_elastic() const noexcept
+    {
+        return options.min_concurency < options.concurency;
+    }
+
+    void task_pool::spawn_workers(size_t count) noexcept
+    {
+        auto retired = std::vector<jthread>{};
+        {
+            auto lock = std::unique_lock<std::mutex>{threads_mutex};
+            if (stopped)
+            {
+                return;
+            }
+
+            for (size_t index = 0; index < worker_queues.size() && count > 0; index++)
+            {
+                auto& worker = worker_queues[index];
+                if (worker.active)
+                {
+                    continue;
+                }
+
+                // The retired thread may still run on_thread_stop, which may
+                // enqueue and get here, also on an other retired thread.
+                // Joining it could deadlock, so it is only joined once it
+                // exited, see reap_threads.
+                if (worker.thread.joinable())
+                {
+                    retired_threads.push_back(std::move(worker.thread));
+                }
+
+                worker.active = true;
+                active_count++;
+                worker.thread = jthread([this, index] () {
+                    thread_func(index);
+                });
+                count--;
+            }
+
+            retired = reap_threads();
+        }
+
+        // the threads are past all code that could wait on this one
+        for (auto& thread : retired)
+        {
+            thread.join();
+        }
+    }
+
+    std::vector<jthread> task_pool::reap_threads() noexcept
+    {
+        auto exited = std::vector<jthread>{};
+        auto i = begin(retired_threads);
+        while (i != end(retired_threads))
+        {
+            auto id = std::find(begin(exited_threads), end(exited_threads), i->get_id());
+            if (id == end(exited_threads))
+            {
+                ++i;
+                continue;
+            }
+
+            exited_threads.erase(id);
+            exited.push_back(std::move(*i));
+            i = retired_threads.erase(i);
+        }
+        return exited;
+    }
+
+    bool task_pool::retire_worker(size_t index) noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{threads_mutex};
+        if (stopped || index < options.hot_workers || active_count <= options.min_concurency)
+        {
+            return false;
+        }
+
+        active_count--;
+        if (has_work())
+        {
+            // a task was enqueued while the pool did not see the retiring thread
+            active_count++;
+            return false;
+        }
+
+        worker_queues[index].active = false;
+        return true;
+    }
+
+    void task_pool::thread_func(size_t index) noexcept
+    {
+        this_task_pool    = this;
+        this_worker_index = index;
+
+        if (auto cpu = worker_queues[index].cpu)
+        {
+            set_thread_affinity(*cpu);
+        }
+
+        if (options.on_thread_start)
+        {
+            options.on_thread_start(index);
+        }
+
+        while (true)
+        {
+            if (auto task = next_task(index))
+            {
+                execute(task);
+                continue;
+            }
+
+            if (spin(index))
+            {
+                continue;
+            }
+
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            if (stopped && !has_work())
+            {
+                break;
+            }
+            if (is_elastic())
+            {
+                auto woken = park(lock, index, std::chrono::steady_clock::now() + options.idle_timeout);
+                if (!woken && retire_worker(index))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                park(lock, index, std::nullopt);
+            }
+        }
+
+        // Tasks enqueued from on_thread_stop count as external, since a
+        // retired thread may overlap with the thread that replaces it.
+        this_task_pool = nullptr;
+
+        if (options.on_thread_stop)
+        {
+            options.on_thread_stop(index);
+        }
+
+        // from here on the thread does not wait on anything, so it may be joined
+        auto lock = std::unique_lock<std::mutex>{threads_mutex};
+        exited_threads.push_back(std::this_thread::get_id());
     }
 }
@@ -19,24 +19,153 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+
 #ifndef _C9Y_TASK_POOL_H_
 #define _C9Y_TASK_POOL_H_
 
 #include <functional>
 #include <thread>
 #include <vector>
+#include <deque>
+#include <iterator>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <memory>
+#include <type_traits>
 
 #include "defines.h"
-#include "thread_pool.h"
-#include "queue.h"
+#include "jthread.h"
+#include "affinity.h"
+#include "executor.h"
+#include "fiber.h"
+#include "task.h"
+#include "utils.h"
 
 namespace c9y
 {
+    //! Task Priority
+    enum class priority
+    {
+        //! Tasks that are served before any other task.
+        high,
+        //! The default priority.
+        normal,
+        //! Tasks that are served when there is nothing else to do.
+        background
+    };
+
+    //! Task Pool Options
+    struct task_pool_options
+    {
+        //! The number of threads to spawn.
+        //!
+        //! For an elastic pool, this is the maximum number of threads.
+        size_t concurency = std::thread::hardware_concurrency();
+
+        //! The minimum number of threads to keep running.
+        //!
+        //! If min_concurency is lower than concurency, the pool is elastic.
+        //! It starts with min_concurency threads and spawns more, up to
+        //! concurency, when tasks stay queued over several consecutive
+        //! checks while no worker is idle. A short burst of tasks is served
+        //! by the running threads. Threads that were idle for idle_timeout
+        //! retire, until min_concurency threads are left.
+        //!
+        //! By default all threads are spawned on construction and kept.
+        size_t min_concurency = std::numeric_limits<size_t>::max();
+
+        //! How long a thread of an elastic pool is idle before it retires.
+        std::chrono::milliseconds idle_timeout = std::chrono::milliseconds(1000);
+
+        //! How long an idle worker spins looking for work before it parks.
+        //!
+        //! While spinning the worker first pauses with an exponential backoff
+        //! and then yields. Spinning avoids the cost of sleeping and waking
+        //! up for bursty workloads, at the cost of burning CPU time. With the
+        //! default of zero, workers park right away.
+        std::chrono::microseconds spin_duration = std::chrono::microseconds(0);
+
+        //! The number of workers that never park.
+        //!
+        //! Hot workers keep spinning until the pool is destroyed, so tasks
+        //! are picked up with the lowest possible latency.
+        size_t hot_workers = 0u;
+
+        //! How often a worker serves the lower priority lanes first.
+        //!
+        //! Every starvation_limit-th time a worker looks for work, it checks
+        //! the background and normal lanes before the high priority lane.
+        //! This ensures that lower priority work makes progress, even when
+        //! the pool is flooded with higher priority tasks. Zero disables
+        //! the starvation protection.
+        size_t starvation_limit = 64u;
+
+        //! The number of consecutive tasks a worker takes from it's LIFO slot.
+        //!
+        //! A task enqueued from a worker is placed in that worker's LIFO slot
+        //! and runs next on the same worker, while the data it shares with
+        //! it's parent is still in the cache. The previous occupant of the
+        //! slot moves to the worker's deque. Other workers only steal from the
+        //! slot when there is no other work. After lifo_limit tasks from the
+        //! slot in a row, the slot is flushed to the deque, so that a chain of
+        //! continuations can not monopolise the worker. Zero disables the slot.
+        size_t lifo_limit = 16u;
+
+        //! The maximum number of queued tasks.
+        //!
+        //! When the pool holds capacity tasks that have not yet started,
+        //! enqueue blocks until a worker takes a task. Tasks enqueued from
+        //! the pool's own workers are exempt, since blocking a worker could
+        //! deadlock the pool. The capacity is a soft limit; concurrent
+        //! producers and enqueue_bulk may overshoot it by one enqueue each.
+        //! Zero means unbounded.
+        size_t capacity = 0u;
+
+        //! The placement of the worker threads.
+        //!
+        //! If the workers are pinned to CPUs on more than one NUMA node, each
+        //! node gets it's own injection queue. Tasks enqueued from outside the
+        //! pool are placed in the queue of the node the calling thread runs on
+        //! and workers prefer tasks from their own node, also when stealing.
+        thread_placement placement = {};
+
+        //! Called on each worker with it's index, before it executes tasks.
+        //!
+        //! Use this to warm up thread local state, such as caches or
+        //! allocator arenas, before the first task arrives. For an elastic
+        //! pool the hook is called each time a worker is spawned.
+        std::function<void (size_t)> on_thread_start = {};
+
+        //! Called on each worker with it's index, when it terminates or retires.
+        //!
+        //! The thread no longer counts as worker of the pool. When a retired
+        //! thread is replaced, on_thread_stop may still run while the new
+        //! thread calls on_thread_start with the same index.
+        std::function<void (size_t)> on_thread_stop = {};
+    };
+
     //! Task Pool
     //!
     //! A task pool is a pool of threads that are executing heterogeneous tasks.
-    class C9Y_EXPORT task_pool
+    //!
+    //! The task pool is implemented as a work stealing scheduler. Each worker
+    //! owns a local deque of tasks. Tasks that are enqueued from within a worker
+    //! are pushed onto that worker's deque and the worker pops them from the
+    //! same end. Tasks that are enqueued from outside the pool go through a
+    //! shared injection queue. Workers that run out of work steal from the
+    //! other end of a random victim's deque.
+    //!
+    //! An elastic pool spawns it's threads lazily and retires them when they
+    //! are idle; see task_pool_options::min_concurency.
+    //!
+    //! Tasks with high or background priority are placed in separate lanes.
+    //! Workers serve high priority tasks first, then normal tasks and only
+    //! when there is nothing else to do background tasks.
+    class C9Y_EXPORT task_pool : public executor
     {
     public:
         //! Construct task pool with given concurrency.
@@ -44,26 +173,366 @@ namespace c9y
         //! @param concurency the number of threads spawn.
         explicit task_pool(size_t concurency) noexcept;
 
+        //! Construct task pool with the given options.
+        //!
+        //! @param options the options of the task pool
+        explicit task_pool(const task_pool_options& options) noexcept;
+
         //! Destructor
         ~task_pool();
 
         //! Add a task to the work queue.
-        void enqueue(const std::function<void ()>& func) noexcept;
+        //!
+        //! If called from one of this pool's workers, the task is pushed onto
+        //! the worker's local deque, else it is added to the injection queue.
+        void enqueue(task func) noexcept override;
+
+        //! Try to add a task to the work queue without blocking.
+        //!
+        //! @param func the task to execute; it is only moved from on success
+        //! @returns false if the pool is at capacity
+        [[nodiscard]] bool try_enqueue(task&& func) noexcept;
+
+        //! Add a task to the work queue, waiting at most timeout for capacity.
+        //!
+        //! @param timeout the longest time to wait for capacity
+        //! @param func the task to execute; it is only moved from on success
+        //! @returns false if the pool was still at capacity after timeout
+        [[nodiscard]] bool enqueue_for(std::chrono::steady_clock::duration timeout, task&& func) noexcept;
+
+        //! Add a task with the given priority to the work queue.
+        //!
+        //! Tasks with normal priority are handled as by enqueue(func),
+        //! the others are added to the shared lane of their priority.
+        //!
+        //! @param prio the priority of the task
+        //! @param func the task to execute
+        void enqueue(priority prio, task func) noexcept;
+
+        //! Add a task to the worker that owns a key.
+        //!
+        //! Tasks with the same key are routed to the same worker, so that
+        //! the data they touch stays in that core's cache. Keys are mapped
+        //! onto the running workers; when an elastic pool grows or shrinks,
+        //! a key may move to another worker. The owner serves it's keyed
+        //! tasks oldest first, after the tasks it enqueued itself, and is
+        //! woken for them if it is idle. This is not a hard pinning; while
+        //! the owner is busy, workers that have nothing else to do steal
+        //! it's keyed tasks. The tasks of one key are therefore not ordered,
+        //! use a strand for that.
+        //!
+        //! @param key the key, for example a shard or partition number
+        //! @param func the task to execute
+        void enqueue(size_t key, task func) noexcept;
+
+        //! Add a cancellable task to the work queue.
+        //!
+        //! If stop is requested on the token before the task starts, the
+        //! task is dropped without calling func. A task that already runs
+        //! is not interrupted, but func may check the token itself.
+        //!
+        //! @param token the token to cancel the task
+        //! @param func the function to execute
+        template <typename Callable>
+        requires std::is_invocable_v<std::decay_t<Callable>&>
+        void enqueue(stop_token token, Callable&& func) noexcept
+        {
+            enqueue(priority::normal, std::move(token), std::forward<Callable>(func));
+        }
+
+        //! Add a cancellable task with the given priority to the work queue.
+        //!
+        //! @param prio the priority of the task
+        //! @param token the token to cancel the task
+        //! @param func the function to execute
+        template <typename Callable>
+        requires std::is_invocable_v<std::decay_t<Callable>&>
+        void enqueue(priority prio, stop_token token, Callable&& func) noexcept
+        {
+            // wrapping the callable and not a task keeps small callables inline
+            enqueue(prio, [token = std::move(token), func = std::forward<Callable>(func)] () mutable {
+                if (!token.stop_requested())
+                {
+                    func();
+                }
+            });
+        }
+
+        //! Add a range of tasks to the work queue.
+        //!
+        //! All tasks are added under one lock acquisition and only as many
+        //! workers are woken as there are tasks.
+        //!
+        //! @param first the beginning of the range
+        //! @param last the end of the range
+        //!
+        //! @note The elements are converted to task by copy; use
+        //! std::make_move_iterator to move them instead.
+        template <typename Iterator>
+        void enqueue_bulk(Iterator first, Iterator last) noexcept
+        {
+            auto count = static_cast<size_t>(std::distance(first, last));
+            if (count == 0)
+            {
+                return;
+            }
+
+            wait_for_capacity(std::nullopt);
+
+            task_created(count);
+
+            auto append = [&] (std::deque<task>& target) {
+                for (; first != last; ++first)
+                {
+                    target.emplace_back(*first);
+                }
+            };
+
+            if (auto local = this_worker())
+            {
+                auto lock = std::unique_lock<std::mutex>{local->mutex};
+                append(local->tasks);
+                local->size += count;
+            }
+            else
+            {
+                auto lane = lane_index(priority::normal, current_node());
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                append(injected[lane]);
+                injected_count[lane] += count;
+            }
+
+            wake(count);
+        }
+
+        //! Add a batch of tasks to the work queue.
+        //!
+        //! The tasks are moved out of the vector in one bulk enqueue.
+        //!
+        //! @param tasks the tasks to execute
+        void enqueue_bulk(std::vector<task>& tasks) noexcept override;
+
+        //! Add a task that runs on it's own fiber.
+        //!
+        //! The task runs on a fiber with a small stack. When it waits on a
+        //! c9y primitive, such as latch, barrier, queue, task_group or a
+        //! parallel algorithm, it suspends and frees the worker for other
+        //! tasks, instead of blocking the thread. Once resumed, it continues
+        //! on any worker of the pool.
+        //!
+        //! Suspended fibers are dropped when the pool is destroyed; objects
+        //! on their stacks are not destroyed. Fibers that are parked on a
+        //! primitive are not resumed; they stay allocated until the
+        //! primitive signals them.
+        //!
+        //! @param func the task to execute
+        //! @param stack_size the size of the fiber's stack
+        void enqueue_fiber(task func, size_t stack_size = fiber::default_stack_size) noexcept;
+
+        //! Add a task to the work queue after a delay.
+        //!
+        //! The task waits in a timer heap that is served by one timer
+        //! thread per pool. Once due, it is enqueued like any other task.
+        //!
+        //! @param delay the time to wait before the task is enqueued
+        //! @param func the task to execute
+        void enqueue_after(std::chrono::steady_clock::duration delay, task func) noexcept;
+
+        //! Add a task to the work queue at a given time.
+        //!
+        //! @param time the time point at which the task is enqueued
+        //! @param func the task to execute
+        void enqueue_at(std::chrono::steady_clock::time_point time, task func) noexcept;
+
+        //! Add a task to the work queue at a fixed rate.
+        //!
+        //! The function is enqueued every period, first after one period.
+        //! The next run is scheduled once the previous run completed, so
+        //! runs never overlap; periods that were missed because a run took
+        //! too long are skipped.
+        //!
+        //! @param period the time between two runs
+        //! @param func the function to execute
+        //! @param token the token to stop the recurring task
+        void enqueue_every(std::chrono::steady_clock::duration period, task func, stop_token token = {}) noexcept;
 
         //! Wait for all pending work to clear.
+        //!
+        //! Tasks that wait for their timer are not pending.
         void flush() noexcept;
 
+        //! Execute pending tasks until a condition is met.
+        //!
+        //! When a task waits for work it enqueued itself, blocking would
+        //! waste the worker and can deadlock the pool once all workers wait.
+        //! Instead, a worker that calls run_until executes pending tasks of
+        //! the pool until done returns true. If there is no work, it waits
+        //! for new tasks or notify_run_until and checks done again.
+        //!
+        //! When called from a thread that is not one of this pool's workers,
+        //! the thread does not execute tasks and only waits for done.
+        //!
+        //! @param done the condition to wait for
+        void run_until(const std::function<bool ()>& done) noexcept override;
+
+        //! Wake the threads waiting in run_until.
+        void notify_run_until() noexcept override;
+
+        //! Check if the calling thread is one of this pool's workers.
+        [[nodiscard]] bool is_worker() const noexcept override;
+
+        //! Get the index of the calling worker in it's task pool.
+        //!
+        //! The index is stable for the lifetime of the worker and lies in
+        //! [0, concurency).
+        //!
+        //! @returns the index or nothing if not called from a worker.
+        [[nodiscard]] static std::optional<size_t> worker_index() noexcept;
+
+        //! Get the number of threads currently running.
+        [[nodiscard]] size_t get_concurency() const noexcept;
+
     private:
-        queue<std::function<void ()>> tasks;
-        thread_pool                   pool;
+        //! A worker and it's local deque.
+        //!
+        //! Each worker sits on it's own cache lines. The counters are
+        //! per worker, so that pushing and popping local tasks does not
+        //! write to memory shared by all workers.
+        struct alignas(cache_line_size) worker
+        {
+            std::mutex              mutex;
+            std::deque<task>        tasks;
+            //! Tasks routed to this worker by key, served oldest first.
+            std::deque<task>        keyed;
+            task                    next;
+            //! The number of tasks in tasks, keyed and next, written under mutex.
+            std::atomic<size_t>     size = 0u;
+            size_t                  streak = 0u;
+            size_t                  ticks = 0u;
+            jthread                 thread;
+            std::atomic<bool>       active = false;
+            //! Set while the worker runs a task, keyed tasks are only stolen from busy owners.
+            std::atomic<bool>       busy = false;
+            std::optional<size_t>   cpu;
+            size_t                  node = 0u;
+
+            //! The worker sleeps on it's own condition with the pool's mutex.
+            std::condition_variable cond;
+            //! Set while the worker is in the idle list, guarded by the pool's mutex.
+            bool                    parked  = false;
+            //! Set while the worker waits in run_until, guarded by the pool's mutex.
+            bool                    helping = false;
+
+            //! The number of tasks enqueued and finished by this worker.
+            //!
+            //! Only written by the worker itself, see in_flight().
+            alignas(cache_line_size) std::atomic<size_t> created  = 0u;
+            std::atomic<size_t>                          finished = 0u;
+        };
+
+        struct timer
+        {
+            std::chrono::steady_clock::time_point time;
+            size_t                                sequence;
+            task                                  func;
+
+            //! Orders the timer heap, so that the earliest timer is at the front.
+            [[nodiscard]] bool operator > (const timer& other) const noexcept
+            {
+                return time != other.time ? time > other.time : sequence > other.sequence;
+            }
+        };
+
+        //! Resumes parked fibers, outlives the pool in the fibers' wake tasks.
+        struct fiber_scheduler
+        {
+            std::mutex mutex;
+            task_pool* pool = nullptr;
+        };
+
+        static constexpr size_t lane_count = 3u;
+
+        task_pool_options                           options;
+        std::vector<worker>                         worker_queues;
+        std::mutex                                  threads_mutex;
+        // replaced threads that may still run on_thread_stop, joined once they exited
+        std::vector<jthread>                        retired_threads;
+        std::vector<std::thread::id>                exited_threads;
+        std::atomic<size_t>                         active_count = 0u;
+        size_t                                      node_count = 1u;
+        std::vector<size_t>                         cpu_nodes;
+
+        alignas(cache_line_size) std::mutex         mutex;
+        std::vector<size_t>                         idle;
+        std::vector<std::deque<task>>               injected;
+        std::vector<std::atomic<size_t>>            injected_count;
+        std::atomic<bool>                           stopped = false;
+
+        // the size of idle, only written when a worker goes to sleep or wakes up
+        alignas(cache_line_size) std::atomic<size_t> sleeping = 0;
+        std::atomic<size_t>                         helping   = 0u;
+        std::atomic<size_t>                         run_epoch = 0u;
+        std::atomic<bool>                           grow_armed = false;
+
+        // tasks enqueued and finished by threads that are not workers
+        alignas(cache_line_size) std::atomic<size_t> external_created  = 0u;
+        std::atomic<size_t>                         external_finished = 0u;
+        std::atomic<size_t>                         flush_waiting     = 0u;
+        std::mutex                                  flush_mutex;
+        std::condition_variable                     flush_cv;
+
+        std::mutex                                  capacity_mutex;
+        std::condition_variable                     capacity_cond;
+        std::atomic<size_t>                         producers_waiting = 0u;
+
+        std::mutex                                  timer_mutex;
+        std::condition_variable                     timer_cond;
+        std::vector<timer>                          timers;
+        size_t                                      timer_sequence = 0u;
+        bool                                        timer_stopped  = false;
+        std::optional<std::chrono::steady_clock::time_point> grow_check;
+        size_t                                      backlog_checks = 0u;
+        jthread                                     timer_thread;
 
-        std::atomic<unsigned int>     tasks_in_flight = 0;
-        std::mutex                    flush_mutex;
-        std::condition_variable       flush_cv;
+        std::shared_ptr<fiber_scheduler>            scheduler;
 
-        void thread_func() noexcept;
+        void thread_func(size_t index) noexcept;
+        [[nodiscard]] bool is_elastic() const noexcept;
+        void spawn_workers(size_t count) noexcept;
+        [[nodiscard]] bool retire_worker(size_t index) noexcept;
+        [[nodiscard]] std::vector<jthread> reap_threads() noexcept;
+        void execute(task& func) noexcept;
+        [[nodiscard]] worker* this_worker() noexcept;
+        void wake(size_t count) noexcept;
+        void wake_owner(size_t index) noexcept;
+        bool park(std::unique_lock<std::mutex>& lock, size_t index, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept;
+        void unpark(size_t index) noexcept;
+        [[nodiscard]] size_t key_owner(size_t key) const noexcept;
+        void grow() noexcept;
+        [[nodiscard]] bool check_growth() noexcept;
+        void start_timer_thread() noexcept;
+        [[nodiscard]] bool spin(size_t index) noexcept;
+        [[nodiscard]] task pop_local(size_t index) noexcept;
+        [[nodiscard]] size_t current_node() const noexcept;
+        [[nodiscard]] size_t lane_index(priority prio, size_t node) const noexcept;
+        [[nodiscard]] task pop_injected(priority prio, size_t index) noexcept;
+        [[nodiscard]] task pop_lane(size_t lane, size_t index, bool batch) noexcept;
+        [[nodiscard]] task steal(size_t index) noexcept;
+        [[nodiscard]] task next_task(size_t index) noexcept;
+        void timer_func() noexcept;
+        void resume_fiber(std::shared_ptr<fiber> f) noexcept;
+        void task_created(size_t count) noexcept;
+        void task_done() noexcept;
+        [[nodiscard]] size_t in_flight() const noexcept;
+        [[nodiscard]] size_t queued() const noexcept;
+        [[nodiscard]] bool has_work() const noexcept;
+        [[nodiscard]] bool is_exempt() const noexcept;
+        bool wait_for_capacity(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept;
+        void push(priority prio, task func) noexcept;
+        void enqueue_recurring(std::shared_ptr<task> func, std::chrono::steady_clock::time_point time,
+                               std::chrono::steady_clock::duration period, stop_token token) noexcept;
 
-        task_pool(const thread_pool&) = delete;
+        task_pool(const task_pool&) = delete;
         task_pool& operator = (const task_pool&) = delete;
     };
 }
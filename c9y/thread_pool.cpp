@@ -30,6 +30,30 @@
 
 namespace c9y
 {
+    thread_local std::optional<size_t> this_thread_index;
+
+    void _thread_setup::enter() const
+    {
+        this_thread_index = index;
+        if (cpu)
+        {
+            set_thread_affinity(*cpu);
+        }
+        if (on_start)
+        {
+            on_start(index);
+        }
+    }
+
+    void _thread_setup::leave() const
+    {
+        if (on_stop)
+        {
+            on_stop(index);
+        }
+        this_thread_index = std::nullopt;
+    }
+
     size_t thread_pool::get_concurency() const
     {
         return threads.size();
@@ -45,6 +69,11 @@ namespace c9y
         }
     }
 
+    std::optional<size_t> thread_pool::thread_index() noexcept
+    {
+        return this_thread_index;
+    }
+
     bool thread_pool::request_stop() noexcept
     {
         auto result = false;
@@ -24,12 +24,45 @@
 
 #include <functional>
 #include <vector>
+#include <optional>
 
 #include "defines.h"
 #include "jthread.h"
+#include "affinity.h"
 
 namespace c9y
 {
+    //! Thread Pool Options
+    struct thread_pool_options
+    {
+        //! The number of threads to run concurently.
+        size_t concurency = std::thread::hardware_concurrency();
+
+        //! The CPUs the threads are pinned to.
+        thread_placement placement = {};
+
+        //! Called on each thread with it's index, before the thread function.
+        //!
+        //! Use this to warm up thread local state, such as caches or
+        //! allocator arenas, before the first work arrives.
+        std::function<void (size_t)> on_thread_start = {};
+
+        //! Called on each thread with it's index, after the thread function.
+        std::function<void (size_t)> on_thread_stop = {};
+    };
+
+    //! Per thread setup of a thread pool.
+    struct C9Y_EXPORT _thread_setup
+    {
+        size_t                       index;
+        std::optional<size_t>        cpu;
+        std::function<void (size_t)> on_start;
+        std::function<void (size_t)> on_stop;
+
+        void enter() const;
+        void leave() const;
+    };
+
     //! Thread Pool
     class C9Y_EXPORT thread_pool
     {
@@ -49,10 +82,52 @@ namespace c9y
         //! This constructor will create @arg concurency threads that execute @arg thread_func.
         template <typename Callable>
         thread_pool(Callable thread_func, size_t concurency = std::thread::hardware_concurrency())
+        : thread_pool(thread_func, thread_pool_options{.concurency = concurency}) {}
+
+        //! Create a thread pool with pinned threads.
+        //!
+        //! @param thread_func The thread function each thread in the pool executes.
+        //! @param concurency The number of threads to run concurently.
+        //! @param placement The CPUs the threads are pinned to.
+        //!
+        //! Each thread pins itself before it executes @arg thread_func.
+        template <typename Callable>
+        thread_pool(Callable thread_func, size_t concurency, const thread_placement& placement)
+        : thread_pool(thread_func, thread_pool_options{.concurency = concurency, .placement = placement}) {}
+
+        //! Create a thread pool with options.
+        //!
+        //! @param thread_func The thread function each thread in the pool executes.
+        //! @param options The options of the pool.
+        template <typename Callable>
+        thread_pool(Callable thread_func, const thread_pool_options& options)
         {
-            for (size_t i = 0; i < concurency; i++)
+            auto cpus = get_placement_cpus(options.placement, options.concurency);
+            for (size_t i = 0; i < options.concurency; i++)
             {
-                threads.emplace_back(thread_func);
+                auto setup = _thread_setup{
+                    i,
+                    cpus.empty() ? std::nullopt : std::optional<size_t>{cpus[i]},
+                    options.on_thread_start,
+                    options.on_thread_stop
+                };
+
+                if constexpr (std::is_invocable_v<Callable, stop_token>)
+                {
+                    threads.emplace_back([thread_func, setup] (stop_token token) mutable {
+                        setup.enter();
+                        thread_func(token);
+                        setup.leave();
+                    });
+                }
+                else
+                {
+                    threads.emplace_back([thread_func, setup] () mutable {
+                        setup.enter();
+                        thread_func();
+                        setup.leave();
+                    });
+                }
             }
         }
 
@@ -82,6 +157,11 @@ namespace c9y
         //! @returns true if the stop request could be issues to all threads.
         bool request_stop() noexcept;
 
+        //! Get the index of the calling thread in it's thread pool.
+        //!
+        //! @returns the index or nothing if not called from a pool thread.
+        [[nodiscard]] static std::optional<size_t> thread_index() noexcept;
+
     private:
         std::vector<jthread> threads;
 
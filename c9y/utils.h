@@ -22,8 +22,20 @@
 #pragma once
 #include "defines.h"
 
+#include <chrono>
+#include <future>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace c9y
 {
+    //! Assumed size of a cache line, used to keep hot atomics apart.
+    constexpr size_t cache_line_size = 64u;
+
     //! Check if all waitable items are ready.
     //!
     //!
@@ -49,4 +61,16 @@ namespace c9y
             item.wait();
         }
     }
+
+    //! Hint to the processor that the calling thread is spinning.
+    inline void cpu_relax() noexcept
+    {
+        #if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+        _mm_pause();
+        #elif defined(_M_ARM64) || defined(_M_ARM)
+        __yield();
+        #elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+        #endif
+    }
 }
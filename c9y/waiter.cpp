@@ -0,0 +1,86 @@
+//
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "waiter.h"
+
+#include "fiber.h"
+
+namespace c9y
+{
+    _waiter::_waiter() noexcept
+    : owner(fiber::current()) {}
+
+    void _waiter::signal() noexcept
+    {
+        {
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            signaled = true;
+        }
+
+        // the fiber may be freed by wake, do not touch this afterwards
+        if (owner)
+        {
+            owner->wake();
+        }
+        else
+        {
+            cond.notify_one();
+        }
+    }
+
+    bool _waiter::wait(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+    {
+        auto lock = std::unique_lock<std::mutex>{mutex};
+        if (owner)
+        {
+            // a wake that comes before the fiber parked makes park return right away
+            while (!signaled)
+            {
+                if (deadline && std::chrono::steady_clock::now() >= *deadline)
+                {
+                    return false;
+                }
+                lock.unlock();
+                fiber::park(deadline);
+                lock.lock();
+            }
+        }
+        else
+        {
+            auto pred = [this] { return signaled; };
+            if (deadline)
+            {
+                if (!cond.wait_until(lock, *deadline, pred))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                cond.wait(lock, pred);
+            }
+        }
+        signaled = false;
+        return true;
+    }
+}
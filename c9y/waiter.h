@@ -0,0 +1,266 @@
+// c9y - concurrency
+// Copyright 2017-2023 Sean Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _C9Y_WAITER_H_
+#define _C9Y_WAITER_H_
+
+#include "defines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "fiber.h"
+#include "utils.h"
+
+namespace c9y
+{
+
+    //! Wake up for a thread or fiber that waits on a primitive.
+    //!
+    //! Primitives hold a pointer to this while somebody waits on them and
+    //! signal it under their lock. A waiting thread sleeps on the condition,
+    //! a waiting fiber parks, so that it's worker runs other tasks, and is
+    //! enqueued again by the signal.
+    class C9Y_EXPORT _waiter
+    {
+    public:
+        //! Create a waiter for the calling thread or fiber.
+        _waiter() noexcept;
+
+        //! Wake the waiter.
+        void signal() noexcept;
+
+        //! Wait until signaled and reset the signal.
+        //!
+        //! @param deadline the time after which to give up
+        //! @returns false if the deadline passed without a signal
+        bool wait(std::optional<std::chrono::steady_clock::time_point> deadline) noexcept;
+
+    private:
+        std::mutex              mutex;
+        std::condition_variable cond;
+        bool                    signaled = false;
+        fiber*                  owner;
+
+        _waiter(const _waiter&) = delete;
+        _waiter& operator = (const _waiter&) = delete;
+    };
+
+    //! The waiters of a primitive, guarded by the primitive's lock.
+    class _wait_list
+    {
+    public:
+        //! Check if nobody waits.
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return waiters.empty();
+        }
+
+        void add(_waiter* waiter)
+        {
+            waiters.push_back(waiter);
+        }
+
+        void remove(_waiter* waiter) noexcept
+        {
+            waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+        }
+
+        //! Wake the longest waiting waiter and remove it from the list.
+        void notify_one() noexcept
+        {
+            if (!waiters.empty())
+            {
+                auto waiter = waiters.front();
+                waiters.erase(waiters.begin());
+                waiter->signal();
+            }
+        }
+
+        //! Wake all waiters and clear the list.
+        void notify_all() noexcept
+        {
+            auto woken = std::exchange(waiters, {});
+            for (auto waiter : woken)
+            {
+                waiter->signal();
+            }
+        }
+
+        //! Wait until ready returns true, like condition_variable::wait.
+        //!
+        //! The lock must hold the primitive's mutex. The waiter is removed
+        //! again before this returns, so it never outlives the call.
+        //!
+        //! @param lock the lock on the primitive's mutex
+        //! @param ready the condition to wait for, checked under the lock
+        //! @param deadline the time after which to give up
+        //! @returns the result of the last check of ready
+        template <typename Pred>
+        bool wait(std::unique_lock<std::mutex>& lock, Pred ready, std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt)
+        {
+            auto waiter = _waiter{};
+            while (!ready())
+            {
+                if (deadline && std::chrono::steady_clock::now() >= *deadline)
+                {
+                    return false;
+                }
+
+                add(&waiter);
+                lock.unlock();
+                waiter.wait(deadline);
+                lock.lock();
+                remove(&waiter);
+            }
+            return true;
+        }
+
+    private:
+        std::vector<_waiter*> waiters;
+    };
+
+    //! Parks the waiting side of a lock free queue.
+    //!
+    //! The queues only lock while somebody is parked. A waiter counts itself
+    //! in waiting before it checks a last time under the mutex; the other
+    //! side publishes it's change, checks waiting and only then locks to wake.
+    class _parking
+    {
+    public:
+        //! Spin and then park until op succeeds, the queue is stopped or the deadline passes.
+        //!
+        //! @param op the operation to retry, returns true on success
+        //! @param stopped the stop flag of the queue
+        //! @param deadline the time after which to give up
+        //! @returns true if op succeeded
+        template <typename Operation>
+        bool wait(Operation op, const std::atomic<bool>& stopped, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            return spin(op, stopped) || park(op, stopped, deadline);
+        }
+
+        //! Retry op for a short while, a value often arrives shortly.
+        template <typename Operation>
+        bool spin(Operation op, const std::atomic<bool>& stopped) noexcept
+        {
+            for (auto i = 0u; i < spin_count; i++)
+            {
+                if (op())
+                {
+                    return true;
+                }
+                if (stopped.load())
+                {
+                    return false;
+                }
+                cpu_relax();
+            }
+            return false;
+        }
+
+        //! Park until op succeeds, the queue is stopped or the deadline passes.
+        //!
+        //! A thread sleeps on the condition, a fiber parks on the wait list.
+        template <typename Operation>
+        bool park(Operation op, const std::atomic<bool>& stopped, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+        {
+            auto done = false;
+            auto pred = [&] () {
+                done = op();
+                return done || stopped.load();
+            };
+
+            auto lock = std::unique_lock<std::mutex>{mutex};
+            waiting.fetch_add(1u);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (fiber::current())
+            {
+                fibers.wait(lock, pred, deadline);
+            }
+            else if (deadline)
+            {
+                cond.wait_until(lock, *deadline, pred);
+            }
+            else
+            {
+                cond.wait(lock, pred);
+            }
+            waiting.fetch_sub(1u);
+            return done;
+        }
+
+        //! Check if somebody is parked.
+        //!
+        //! The caller must order it's change before this load, either with
+        //! a fence, see notify, or with a lock the last check also takes.
+        [[nodiscard]] bool has_waiters() const noexcept
+        {
+            return waiting.load(std::memory_order_relaxed) != 0u;
+        }
+
+        //! Wake a parked waiter, if any, after a change was published.
+        void notify() noexcept
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (has_waiters())
+            {
+                wake_one();
+            }
+        }
+
+        //! Wake one parked waiter.
+        void wake_one() noexcept
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                fibers.notify_one();
+            }
+            cond.notify_one();
+        }
+
+        //! Wake all parked waiters, for example after the queue was stopped.
+        void wake_all() noexcept
+        {
+            {
+                auto lock = std::unique_lock<std::mutex>{mutex};
+                fibers.notify_all();
+            }
+            cond.notify_all();
+        }
+
+    private:
+        static constexpr auto spin_count = 64u;
+
+        std::mutex              mutex;
+        std::condition_variable cond;
+        _wait_list              fibers;
+        std::atomic<size_t>     waiting = 0u;
+    };
+}
+
+#endif